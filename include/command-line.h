@@ -0,0 +1,81 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+/*! \file   command-line.h
+
+    Simple parsing of the command line
+*/
+
+#include <set>
+#include <string>
+#include <vector>
+
+// -----------  command_line  ----------------
+
+/*!     \class command_line
+        \brief access the command line in a more convenient manner
+
+        Options begin with "--". An option listed as taking a value consumes the
+        following argument; all other arguments are positional
+*/
+
+class command_line
+{
+protected:
+
+  std::vector<std::string> _args;                   ///< all the arguments, excluding the program name
+  std::set<std::string>    _valued_options;         ///< options that are followed by a value
+
+public:
+
+/*! \brief                      Constructor
+    \param  argc                number of arguments (including the program name)
+    \param  argv                the arguments
+    \param  valued_options      options that take a value
+*/
+  command_line(const int argc, char** argv, const std::set<std::string>& valued_options = { });
+
+/*! \brief      Is a particular parameter present?
+    \param  p   parameter for which to test
+    \return     whether <i>p</i> is present
+*/
+  bool parameter_present(const std::string& p) const;
+
+/*! \brief      Is a particular valued option present (with a value)?
+    \param  v   option for which to test
+    \return     whether <i>v</i> is present and is followed by a value
+*/
+  bool value_present(const std::string& v) const;
+
+/*! \brief      Get the value of a valued option
+    \param  v   option whose value is to be returned
+    \return     the value of option <i>v</i>
+
+    Returns the empty string if <i>v</i> is not present or has no value
+*/
+  std::string value(const std::string& v) const;
+
+/*! \brief      Get the value of a valued option, or a default
+    \param  v   option whose value is to be returned
+    \param  d   default value
+    \return     the value of option <i>v</i>, or <i>d</i> if <i>v</i> has no value
+*/
+  inline std::string value(const std::string& v, const std::string& d) const
+    { return (value_present(v) ? value(v) : d); }
+
+/// all the positional (i.e., non-option) arguments, in order
+  std::vector<std::string> positional(void) const;
+
+/// all the options that are not known, in order
+  std::vector<std::string> unknown_options(const std::set<std::string>& known_parameters) const;
+};
+
+#endif    // COMMAND_LINE_H
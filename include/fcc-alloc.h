@@ -0,0 +1,50 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+#ifndef FCC_ALLOC_H
+#define FCC_ALLOC_H
+
+/*! \file   fcc-alloc.h
+
+    Counting the allocations made by each thread.
+
+    The global operators new and delete are replaced; when tracking is enabled they count
+    the allocations and the bytes allocated and freed by the calling thread, using the
+    usable size of each block. Nothing is counted unless tracking has been enabled
+*/
+
+#include <cstdint>
+
+/// the allocations made by a thread
+struct alloc_counts
+{ uint64_t n_allocs    { 0 };       ///< number of allocations
+  uint64_t bytes       { 0 };       ///< number of bytes allocated
+  int64_t  live_bytes  { 0 };       ///< bytes allocated less bytes freed; may be negative if the thread frees blocks allocated elsewhere
+  int64_t  peak_bytes  { 0 };       ///< maximum of live_bytes since the last call to reset_peak_alloc_bytes()
+};
+
+/// enable or disable tracking
+void enable_alloc_tracking(const bool b = true);
+
+/// is tracking enabled?
+bool alloc_tracking_enabled(void);
+
+/// the counts for the calling thread
+alloc_counts thread_alloc_counts(void);
+
+/*! \brief      Set the peak number of live bytes of the calling thread to the current number
+    \return     the previous peak
+*/
+int64_t reset_peak_alloc_bytes(void);
+
+/*! \brief          Ensure that the peak number of live bytes of the calling thread is at least a particular value
+    \param  peak    the value
+*/
+void restore_peak_alloc_bytes(const int64_t peak);
+
+#endif    // FCC_ALLOC_H
@@ -14,17 +14,31 @@
     Headers for program to process and merge FCC .DAT files 
 */
 
+#include "fcc-stats.h"
 #include "fcc-strings.h"
 
 #include <algorithm>
 #include <array>
+#include <bitset>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <ranges>
 #include <stdexcept>
 #include <unordered_map>
+#include <vector>
 
 using namespace std::string_literals;
 
+/// the set of fields of a record of type <i>T</i> that are to be kept when the record is parsed
+template <typename T>
+using column_mask = std::bitset<static_cast<size_t>(T::N_FIELDS)>;
+
+/// a mask that keeps every field
+template <typename T>
+inline column_mask<T> all_columns(void)
+  { return column_mask<T>().set(); }
+
 // -----------  dat_record  ----------------
 
 /*!     \class dat_record
@@ -47,23 +61,55 @@ public:
 
 // construct from string
   dat_record(const std::string& str)
+    { assign(str); }
+
+// construct from string
+  explicit dat_record(const std::string_view str)
+    { assign(str); }
+
+// construct from string, keeping only some of the fields
+  dat_record(const std::string_view str, const column_mask<T>& columns)
+    { assign(str, columns); }
+
+/*! \brief      Replace the contents with those of a line from a .DAT file
+    \param  str the line
+
+    The fields are split in place and copied directly into the existing strings, whose storage is reused,
+    so that parsing a record into a recycled dat_record does not normally allocate. Throws range_error
+    if <i>str</i> does not contain the right number of fields
+*/
+  inline void assign(const std::string_view str)
+    { assign(str, all_columns<T>()); }
+
+/*! \brief          Replace the contents with some of the fields of a line from a .DAT file
+    \param  str     the line
+    \param  columns the fields to keep; the others are left empty
+
+    Throws range_error if <i>str</i> does not contain the right number of fields
+*/
+  void assign(const std::string_view str, const column_mask<T>& columns)
   { if (str.empty())
       throw std::range_error("Empty record string");
-      
-    std::vector<std::string> vec { split_string(to_upper(str), "|"s) };    // force upper case
-  
-// if the last character of the line is a "|", then there is an implied empty string at the end
-    if (str[str.length() - 1] == '|')
-      vec.push_back(std::string());
-  
-    if (vec.size() != static_cast<size_t>(T::N_FIELDS))
-      throw std::range_error("Incorrect number of fields in record string: "s + str + "; should be " + ::to_string(static_cast<size_t>(T::N_FIELDS)) + "; found " + ::to_string(vec.size()));
-  
-    std::move(vec.begin(), vec.end(), _data.begin());   
+
+    std::array<std::string_view, static_cast<size_t>(T::N_FIELDS)> fields;
+
+    const size_t n_fields { split_string(str, '|', fields) };      // a trailing "|" implies an empty string at the end
+
+    if (n_fields != static_cast<size_t>(T::N_FIELDS))
+      throw std::range_error("Incorrect number of fields in record string: "s + std::string(str) + "; should be " + ::to_string(static_cast<size_t>(T::N_FIELDS)) + "; found " + ::to_string(n_fields));
+
+    for (size_t n = 0; n < static_cast<size_t>(T::N_FIELDS); ++n)
+    { if (columns.test(n))
+      { _data[n].assign(fields[n]);
+        to_upper_in_place(_data[n]);                               // force upper case
+      }
+      else
+        _data[n].clear();
+    }
   }
   
 /// access the string at a particular field number
-  inline std::string operator[](const T index) const
+  inline const std::string& operator[](const T index) const
     { return _data.at(static_cast<size_t>(index)); }
 
 /// access the string at a particular field number    
@@ -71,16 +117,50 @@ public:
     { return _data.at(static_cast<size_t>(index)); }
 
 /// access the string at a particular field number
-  inline std::string operator[](const int n) const
+  inline const std::string& operator[](const int n) const
     { return _data.at(static_cast<size_t>(n)); }
 
+/// access the string at a particular field number, without copying it
+  inline const std::string& field(const size_t n) const
+    { return _data[n]; }
+
+/// access the string at a particular field number, known at compile time
+  template <T F>
+  inline const std::string& get(void) const
+    { return std::get<static_cast<size_t>(F)>(_data); }
+
+/// access the string at a particular field number, known at compile time
+  template <T F>
+  inline std::string& get(void)
+    { return std::get<static_cast<size_t>(F)>(_data); }
+
 /// convert to a string: FIELD_1|FIELD_2|FIELD_3...    
   std::string to_string(void) const
   { std::string rv;
-  
-    for (size_t n = 0; n < static_cast<size_t>(T::N_FIELDS); ++n)
-      rv += ( _data[n] + ( n < (static_cast<size_t>(T::N_FIELDS) - 1) ? "|"s : ""s ) );
-      
+
+    rv.reserve(string_length());
+    append_to(rv);
+
+    return rv;
+  }
+
+/// append the string returned by to_string() to <i>str</i>, without creating any temporary strings
+  void append_to(std::string& str) const
+  { for (size_t n = 0; n < static_cast<size_t>(T::N_FIELDS); ++n)
+    { if (n)
+        str += '|';
+
+      str += _data[n];
+    }
+  }
+
+/// the length of the string returned by to_string()
+  size_t string_length(void) const
+  { size_t rv { static_cast<size_t>(T::N_FIELDS) - 1 };      // the separators
+
+    for (const std::string& field : _data)
+      rv += field.size();
+
     return rv;
   }
 };
@@ -102,21 +182,55 @@ public:
   dat_file(void) = default;
   
 // construct from filename
-  dat_file(const std::string& fn)
-  { std::vector<std::string> lines { to_lines(remove_char(read_file(fn), '\r')) };      // remove CR characters
+  explicit dat_file(const std::string& fn) :
+    dat_file(fn, read_file(fn))
+  { }
+
+/*! \brief              Construct from the contents of a file
+    \param  fn          name of the file; used only in messages
+    \param  contents    contents of the file
+    \param  columns     the fields to keep in each record; the others are left empty
+*/
+  dat_file(const std::string& fn, const std::string& contents, const column_mask<T>& columns = all_columns<T>())
+  { const std::string base_fn { fn.substr(fn.find_last_of('/') + 1) };      // for the names of the stages
+
+    stage_timer cr_timer("strip CR "s + base_fn);
+
+    const std::string stripped { remove_char(contents, '\r') };            // remove CR characters
+
+    cr_timer.add(contents.size());
+    cr_timer.stop();
+
+    stage_timer utf8_timer("check UTF-8 "s + base_fn);
+
+    const bool ascii { is_ascii(stripped) };                               // if so, no record needs to be checked individually
+
+    utf8_timer.add(stripped.size());
+    utf8_timer.stop();
+
+    stage_timer split_timer("split lines "s + base_fn);
+
+    std::vector<std::string> lines { to_lines(stripped) };
+
+    split_timer.add(stripped.size(), lines.size());
+    split_timer.stop();
+
+    stage_timer parse_timer("parse "s + base_fn);
   
 // the FCC sometimes puts new lines inside a record, so instead of a quick run through
 // the lines with a lambda, we have to proceed with ridiculous caution
     for (size_t n = 0; n < lines.size(); ++n)
-    { std::string this_record { lines[n] };
+    { std::string this_record { std::move(lines[n]) };
         
       while ( (std::count(this_record.begin(), this_record.end(), '|') < (static_cast<int>(T::N_FIELDS) - 1) ) and (n < lines.size() - 1) ) 
         this_record += ("<LF>"s + lines[++n]);        // convert any LFs to strings indicating the presence of an LF
+
+      if (!ascii and !is_valid_utf8(this_record))       // some records contain Latin-1 or CP1252 names and addresses
+        this_record = repair_utf8(this_record);
         
       try
-      { dat_record<T> dr { remove_peripheral_spaces(this_record) };    // this is the line that does all the work
-        
-        this->push_back(dr);            // add record to the object
+      { this->emplace_back(trim_spaces(this_record), columns);     // this is the line that does all the work
+        parse_timer.record(this_record.size() + 1);
       }
         
       catch (const std::range_error& e)
@@ -127,6 +241,147 @@ public:
   }
 };
 
+// -----------  dat_view  ----------------
+
+/*!     \class dat_view
+        \brief a lazy, single-pass view of the records in an FCC .DAT file
+
+        Each record is parsed only when the iterator reaches it, so that a file can be filtered,
+        transformed and merged in constant memory, without building a dat_file. The source may be
+        the contents of a file already in memory, a memory-mapped file or a stream. The records are
+        the same as those in the corresponding dat_file
+*/
+
+template<typename T>
+class dat_view : public std::ranges::view_interface<dat_view<T>>
+{
+protected:
+
+  std::shared_ptr<const memory_mapped_file> _file_p;            ///< the mapped file, if the view owns it
+  std::string_view                          _contents;          ///< the contents, if the source is in memory
+  size_t                                    _posn     { 0 };    ///< position of the next line in <i>_contents</i>
+  std::istream*                             _is_p     { nullptr };  ///< the stream, if the source is a stream
+  dat_record<T>                             _current;           ///< the current record
+  std::string                               _record;            ///< the text of the current record
+  std::string                               _line;              ///< a continuation line of the current record
+  bool                                      _at_end   { false };    ///< whether there are no more records
+
+/*! \brief          Get the next line from the source
+    \param  line    the line, without CR characters or the trailing LF
+    \return         whether there was a line
+*/
+  bool _next_line(std::string& line)
+  { if (_is_p)
+    { if (!std::getline(*_is_p, line))
+        return false;
+    }
+    else
+    { if (_posn >= _contents.size())
+        return false;
+
+      const size_t eol { std::min(_contents.find('\n', _posn), _contents.size()) };
+
+      line.assign(_contents.substr(_posn, eol - _posn));
+      _posn = eol + 1;
+    }
+
+    std::erase(line, '\r');
+    return true;
+  }
+
+/// parse the next record, or mark the end of the view; the buffers and the current record are reused
+  void _advance(void)
+  { if (!_next_line(_record))
+    { _at_end = true;
+      return;
+    }
+
+// the FCC sometimes puts new lines inside a record; see dat_file
+    while ( (std::count(_record.begin(), _record.end(), '|') < (static_cast<int>(T::N_FIELDS) - 1)) and _next_line(_line) )
+    { _record += "<LF>"s;
+      _record += _line;
+    }
+
+    if (!is_valid_utf8(_record))
+      _record = repair_utf8(_record);
+
+    _current.assign(trim_spaces(_record));
+  }
+
+public:
+
+/// iterator over the records; reading a record advances the view
+  class iterator
+  {
+  protected:
+
+    dat_view* _view_p { nullptr };            ///< the view
+
+  public:
+
+    using iterator_concept = std::input_iterator_tag;
+    using difference_type  = std::ptrdiff_t;
+    using value_type       = dat_record<T>;
+
+    iterator(void) = default;
+
+/// constructor
+    explicit iterator(dat_view* view_p) :
+      _view_p(view_p)
+    { }
+
+/// the current record
+    inline const dat_record<T>& operator*(void) const
+      { return _view_p->_current; }
+
+/// move to the next record
+    inline iterator& operator++(void)
+    { _view_p->_advance();
+      return *this;
+    }
+
+/// move to the next record
+    inline void operator++(int)
+      { ++(*this); }
+
+/// is the view exhausted?
+    inline bool operator==(std::default_sentinel_t) const
+      { return _view_p->_at_end; }
+  };
+
+/*! \brief              Constructor
+    \param  contents    the contents of a .DAT file, which must outlive the view
+*/
+  explicit dat_view(const std::string_view contents) :
+    _contents(contents)
+  { }
+
+/*! \brief          Constructor
+    \param  file_p  a mapped .DAT file, which the view shares
+*/
+  explicit dat_view(std::shared_ptr<const memory_mapped_file> file_p) :
+    _file_p(file_p),
+    _contents(_file_p->contents())
+  { }
+
+/*! \brief      Constructor
+    \param  is  a stream containing a .DAT file, which must outlive the view
+*/
+  explicit dat_view(std::istream& is) :
+    _is_p(&is)
+  { }
+
+/// the first record; may be called only once
+  inline iterator begin(void)
+  { _advance();
+    return iterator(this);
+  }
+
+/// the end of the records
+  inline std::default_sentinel_t end(void) const
+    { return std::default_sentinel; }
+};
+
 /* define the contents of each FCC .DAT file; I note that I haven't been able to find definitive
    statements defining the actual meaning of many of the contents of fields.
 
@@ -201,6 +456,9 @@ enum class AM { RECORD_TYPE = 0,
 
 using AM_RECORD = dat_record<AM>;
 using AM_FILE   = dat_file<AM>;
+using AM_VIEW   = dat_view<AM>;
+
+static_assert(std::ranges::view<AM_VIEW> and std::ranges::input_range<AM_VIEW>);      // so that views compose with std::views::filter etc.
 
 // CO -------------------------------------------------------
 
@@ -233,6 +491,7 @@ enum class CO { RECORD_TYPE = 0,
 
 using CO_RECORD = dat_record<CO>;
 using CO_FILE   = dat_file<CO>;;
+using CO_VIEW   = dat_view<CO>;
 
 // EN -------------------------------------------------------
 
@@ -309,6 +568,7 @@ enum class EN { RECORD_TYPE = 0,
 
 using EN_RECORD = dat_record<EN>;
 using EN_FILE   = dat_file<EN>;
+using EN_VIEW   = dat_view<EN>;
 
 // HD -------------------------------------------------------
 
@@ -443,6 +703,7 @@ enum class HD { RECORD_TYPE = 0,
 
 using HD_RECORD = dat_record<HD>;
 using HD_FILE   = dat_file<HD>;
+using HD_VIEW   = dat_view<HD>;
 
 // HS -------------------------------------------------------
 
@@ -471,6 +732,7 @@ enum class HS { RECORD_TYPE = 0,
               
 using HS_RECORD = dat_record<HS>;
 using HS_FILE   = dat_file<HS>;
+using HS_VIEW   = dat_view<HS>;
 
 // LA -------------------------------------------------------
 
@@ -503,6 +765,7 @@ enum class LA { RECORD_TYPE = 0,
 
 using LA_RECORD = dat_record<LA>;
 using LA_FILE   = dat_file<LA>;
+using LA_VIEW   = dat_view<LA>;
 
 // SC -------------------------------------------------------
 
@@ -537,6 +800,7 @@ enum class SC { RECORD_TYPE = 0,
 
 using SC_RECORD = dat_record<SC>;
 using SC_FILE   = dat_file<SC>;
+using SC_VIEW   = dat_view<SC>;
 
 // SF -------------------------------------------------------
 
@@ -575,6 +839,7 @@ enum class SF { RECORD_TYPE = 0,
 
 using SF_RECORD = dat_record<SF>;
 using SF_FILE   = dat_file<SF>;
+using SF_VIEW   = dat_view<SF>;
 
 /* the fields that go into the output file; these have the same names as the fields in the 
   .DAT files except where those names are duplicated in different .DAT files, in which case 
@@ -636,6 +901,238 @@ enum class FCC { ID = 0,                        // 0    // unique system identif
 using FCC_RECORD = dat_record<FCC>;
 using FCC_FILE   = dat_file<FCC>;
 
+/* how the fields of the .DAT files are merged into the output: for each type of .DAT file that is
+   merged, merge_traits<T> defines what to do with a record whose ID is not already present, whether
+   the callsign must match the one already present, and a table that maps the fields of the .DAT file
+   to fields in the output. The merge itself is generated from these tables by fcc_file::operator+=()
+*/
+
+/// the ways in which a field from a .DAT file is transformed when it is merged
+enum class TRANSFORM { COPY = 0,                      // copy the field
+                       DATE,                          // convert a non-empty FCC date to ISO 8601; an empty date does not overwrite
+                       ID                             // copy the field only if the destination is empty
+                     };
+
+/// what to do when merging a record whose ID is not already in the output
+enum class MISSING_ID { CREATE = 0,                   // create a new output record
+                        SKIP,                         // ignore the record
+                        FATAL                         // treat as a fatal error
+                      };
+
+/// the mapping of a field in a .DAT file to a field in the output
+template <typename T>
+struct field_map
+{ T         src;
+  FCC       dst;
+  TRANSFORM transform { TRANSFORM::COPY };
+};
+
+/// how records from a particular type of .DAT file are merged
+template <typename T>
+struct merge_traits;
+
+template <>
+struct merge_traits<AM>
+{ static constexpr const char* name           { "AM" };
+  static constexpr MISSING_ID  missing_id     { MISSING_ID::CREATE };
+  static constexpr bool        check_callsign { false };
+
+  static constexpr std::array fields { field_map<AM> { AM::ID,                         FCC::ID,                         TRANSFORM::ID },
+                                       field_map<AM> { AM::CALLSIGN,                   FCC::CALLSIGN                   },
+                                       field_map<AM> { AM::OPERATOR_CLASS,             FCC::OPERATOR_CLASS             },
+                                       field_map<AM> { AM::GROUP_CODE,                 FCC::GROUP_CODE                 },
+                                       field_map<AM> { AM::REGION_CODE,                FCC::REGION_CODE                },
+                                       field_map<AM> { AM::TRUSTEE_CALLSIGN,           FCC::TRUSTEE_CALLSIGN           },
+                                       field_map<AM> { AM::TRUSTEE_INDICATOR,          FCC::TRUSTEE_INDICATOR          },
+                                       field_map<AM> { AM::SYSTEMATIC_CALLSIGN_CHANGE, FCC::SYSTEMATIC_CALLSIGN_CHANGE },
+                                       field_map<AM> { AM::VANITY_CALLSIGN_CHANGE,     FCC::VANITY_CALLSIGN_CHANGE     },
+                                       field_map<AM> { AM::VANITY_RELATIONSHIP,        FCC::VANITY_RELATIONSHIP        },
+                                       field_map<AM> { AM::PREVIOUS_CALLSIGN,          FCC::PREVIOUS_CALLSIGN          },
+                                       field_map<AM> { AM::PREVIOUS_OPERATOR_CLASS,    FCC::PREVIOUS_OPERATOR_CLASS    },
+                                       field_map<AM> { AM::TRUSTEE_NAME,               FCC::TRUSTEE_NAME               }
+                                     };
+};
+
+template <>
+struct merge_traits<CO>
+{ static constexpr const char* name           { "CO" };
+  static constexpr MISSING_ID  missing_id     { MISSING_ID::FATAL };
+  static constexpr bool        check_callsign { true };
+
+  static constexpr std::array fields { field_map<CO> { CO::COMMENT_DATE, FCC::COMMENT_DATE,   TRANSFORM::DATE },
+                                       field_map<CO> { CO::DESCRIPTION,  FCC::DESCRIPTION    },
+                                       field_map<CO> { CO::STATUS_CODE,  FCC::CO_STATUS_CODE },
+                                       field_map<CO> { CO::STATUS_DATE,  FCC::CO_STATUS_DATE, TRANSFORM::DATE }
+                                     };
+};
+
+// for some EN and HD records, there is no extant key; probably best to skip the record in that case,
+// because we could end up in a horribly inconsistent state because the FCC doesn't seem to maintain
+// internal consistency amongst the .dat files. With any luck, by the following week this record
+// will be fixed as the state should have changed.
+
+template <>
+struct merge_traits<EN>
+{ static constexpr const char* name           { "EN" };
+  static constexpr MISSING_ID  missing_id     { MISSING_ID::SKIP };
+  static constexpr bool        check_callsign { true };
+
+  static constexpr std::array fields { field_map<EN> { EN::ENTITY_NAME,               FCC::ENTITY_NAME               },
+                                       field_map<EN> { EN::FIRST_NAME,                FCC::FIRST_NAME                },
+                                       field_map<EN> { EN::MIDDLE_INITIAL,            FCC::MIDDLE_INITIAL            },
+                                       field_map<EN> { EN::LAST_NAME,                 FCC::LAST_NAME                 },
+                                       field_map<EN> { EN::SUFFIX,                    FCC::SUFFIX                    },
+                                       field_map<EN> { EN::PHONE,                     FCC::PHONE                     },
+                                       field_map<EN> { EN::FAX,                       FCC::FAX                       },
+                                       field_map<EN> { EN::EMAIL,                     FCC::EMAIL                     },
+                                       field_map<EN> { EN::STREET_ADDRESS,            FCC::STREET_ADDRESS            },
+                                       field_map<EN> { EN::CITY,                      FCC::CITY                      },
+                                       field_map<EN> { EN::STATE,                     FCC::STATE                     },
+                                       field_map<EN> { EN::ZIP_CODE,                  FCC::ZIP_CODE                  },
+                                       field_map<EN> { EN::PO_BOX,                    FCC::PO_BOX                    },
+                                       field_map<EN> { EN::ATTENTION_LINE,            FCC::ATTENTION_LINE            },
+                                       field_map<EN> { EN::FRN,                       FCC::FRN                       },
+                                       field_map<EN> { EN::APPLICANT_TYPE_CODE,       FCC::APPLICANT_TYPE_CODE       },
+                                       field_map<EN> { EN::APPLICANT_TYPE_CODE_OTHER, FCC::APPLICANT_TYPE_CODE_OTHER },
+                                       field_map<EN> { EN::STATUS_CODE,               FCC::EN_STATUS_CODE            },
+                                       field_map<EN> { EN::STATUS_DATE,               FCC::EN_STATUS_DATE,           TRANSFORM::DATE }
+                                     };
+};
+
+template <>
+struct merge_traits<HD>
+{ static constexpr const char* name           { "HD" };
+  static constexpr MISSING_ID  missing_id     { MISSING_ID::SKIP };
+  static constexpr bool        check_callsign { true };
+
+  static constexpr std::array fields { field_map<HD> { HD::LICENSE_STATUS,       FCC::LICENSE_STATUS       },
+                                       field_map<HD> { HD::RADIO_SERVICE_CODE,   FCC::RADIO_SERVICE_CODE   },
+                                       field_map<HD> { HD::GRANT_DATE,           FCC::GRANT_DATE,           TRANSFORM::DATE },
+                                       field_map<HD> { HD::EXPIRED_DATE,         FCC::EXPIRED_DATE,         TRANSFORM::DATE },
+                                       field_map<HD> { HD::CANCELLATION_DATE,    FCC::CANCELLATION_DATE,    TRANSFORM::DATE },
+                                       field_map<HD> { HD::ELIGIBILITY_RULE_NUM, FCC::ELIGIBILITY_RULE_NUM },
+                                       field_map<HD> { HD::REVOKED,              FCC::REVOKED              },
+                                       field_map<HD> { HD::CONVICTED,            FCC::CONVICTED            },
+                                       field_map<HD> { HD::ADJUDGED,             FCC::ADJUDGED             },
+                                       field_map<HD> { HD::EFFECTIVE_DATE,       FCC::EFFECTIVE_DATE,       TRANSFORM::DATE },
+                                       field_map<HD> { HD::LAST_ACTION_DATE,     FCC::LAST_ACTION_DATE,     TRANSFORM::DATE },
+                                       field_map<HD> { HD::LICENSEE_NAME_CHANGE, FCC::LICENSEE_NAME_CHANGE }
+                                     };
+};
+
+/// a .DAT file type that can be merged into the output
+template <typename T>
+concept mergeable = requires { merge_traits<T>::fields; };
+
+/// an output record and the key of its call, so that the key is computed only once when the records are sorted
+struct keyed_record
+{ callsign_key      key;                            ///< key of the call
+  const FCC_RECORD* rec_p { nullptr };              ///< the record
+
+  keyed_record(void) = default;
+
+/// constructor
+  explicit keyed_record(const FCC_RECORD& rec) :
+    key(rec.get<FCC::CALLSIGN>()),
+    rec_p(&rec)
+  { }
+};
+
+/*! \brief      Do two records have the same call?
+    \param  kr1 first record
+    \param  kr2 second record
+    \return     whether <i>kr1</i> and <i>kr2</i> have the same call
+*/
+inline bool same_call(const keyed_record& kr1, const keyed_record& kr2)
+  { return ( (kr1.key == kr2.key) and (kr1.key.exact() or (kr1.rec_p->get<FCC::CALLSIGN>() == kr2.rec_p->get<FCC::CALLSIGN>())) ); }
+
+/*! \brief      Is one record earlier than another in the output order?
+    \param  kr1 first record
+    \param  kr2 second record
+    \return     whether <i>kr1</i> appears before <i>kr2</i> in the output
+
+    Records are in callsign order, as defined by the keys of the calls; records with the same callsign are newest first: in
+    descending order of last action date (an ISO 8601 date, so that string order is date order), then in descending order of ID
+*/
+inline bool compare_records(const keyed_record& kr1, const keyed_record& kr2)
+{ if (kr1.key != kr2.key)
+    return (kr1.key < kr2.key);
+
+  const FCC_RECORD& rec1 { *kr1.rec_p };
+  const FCC_RECORD& rec2 { *kr2.rec_p };
+
+  if (!kr1.key.exact() and (rec1.get<FCC::CALLSIGN>() != rec2.get<FCC::CALLSIGN>()))     // long calls that share a key
+    return compare_calls(rec1.get<FCC::CALLSIGN>(), rec2.get<FCC::CALLSIGN>());
+
+  if (rec1.get<FCC::LAST_ACTION_DATE>() != rec2.get<FCC::LAST_ACTION_DATE>())
+    return (rec1.get<FCC::LAST_ACTION_DATE>() > rec2.get<FCC::LAST_ACTION_DATE>());
+
+  return compare_ids(rec2.get<FCC::ID>(), rec1.get<FCC::ID>());
+}
+
+/// what to do with records that have the same call
+enum class DUPLICATES { NEWEST = 0,                   // keep only the first record in the order defined by compare_records()
+                        ALL,                          // keep all the records
+                        REPORT                        // as NEWEST, and report the calls that have more than one record
+                      };
+
+/// the order of the records in the output
+enum class ORDER { CALLSIGN = 0,                      // the order defined by compare_records()
+                   ID,                                // ascending order of ID
+                   NONE                               // the order of the table, which is unspecified
+                 };
+
+// -----------  duplicate_reporter  ----------------
+
+/*!     \class duplicate_reporter
+        \brief report the calls that have more than one record
+
+        The records must be presented in the order defined by compare_records()
+*/
+
+class duplicate_reporter
+{
+protected:
+
+  std::ostream&                                     _ost;                   ///< stream to which the report is written
+  callsign_key                                      _key;                   ///< key of the current call
+  std::string                                       _call;                  ///< the current call
+  std::vector<std::pair<std::string, std::string>>  _group;                 ///< the ID and last action date of each record of the current call
+  size_t                                            _n_calls { 0 };         ///< number of calls that have more than one record
+
+/// report the current call, if it has more than one record
+  void _flush(void);
+
+public:
+
+/*! \brief      Constructor
+    \param  ost stream to which the report is written
+*/
+  explicit duplicate_reporter(std::ostream& ost) :
+    _ost(ost)
+  { }
+
+/// add the next record
+  void operator+=(const keyed_record& kr);
+
+/// finish the report
+  void close(void);
+};
+
+/// the ways in which the output may be divided into separate files
+enum class SHARD_BY { REGION_CODE = 0,                // call area
+                      STATE,
+                      PREFIX                          // callsign prefix; e.g., "KL7"
+                    };
+
+/// the amount of output written
+struct output_totals
+{ uint64_t records { 0 };                               ///< number of records
+  uint64_t bytes   { 0 };                               ///< number of bytes
+};
+
+constexpr size_t MERGE_BATCH_SIZE { 16 };           ///< number of output records located before any of them is merged
+
 // -----------  fcc_file  ----------------
 
 /*!     \class fcc_file
@@ -651,31 +1148,283 @@ class fcc_file : public std::unordered_map<std::string, FCC_RECORD>       // The
                                                                           // that something else would be better
 {
 protected:
+
+  size_t _n_orphans      { 0 };                         ///< number of records ignored because their IDs were not in the file
+  bool   _throw_on_error { false };                     ///< whether a record that cannot be merged throws exception, rather than exiting
+
+/// report that a record cannot be merged; the message has already been written
+  [[noreturn]] void _merge_error(void) const
+  { if (_throw_on_error)
+      throw std::exception();
+
+    exit(-1);
+  }
       
 public:
 
-/// add an AM_RECORD to the file
-  void operator+=(const AM_RECORD& amr);
-  
-/// add a CO_RECORD to the file  
-  void operator+=(const CO_RECORD& cor);
-  
-/// add an EN_RECORD to the file  
-  void operator+=(const EN_RECORD& enr);
-  
-/// add an HD_RECORD to the file  
-  void operator+=(const HD_RECORD& hdr);
+/// set whether a record that cannot be merged throws exception, rather than exiting; for processes that must survive inconsistent files
+  inline void throw_on_error(const bool b)
+    { _throw_on_error = b; }
+
+/*! \brief      Add a record from a .DAT file to the file
+    \param  r   record to add
+
+    The merge is defined by merge_traits<T>
+*/
+  template <mergeable T>
+  void operator+=(const dat_record<T>& r);
+
+/*! \brief      Get the output record into which a record from a .DAT file is to be merged
+    \param  r   record to be merged
+    \return     pointer to the output record, or nullptr if <i>r</i> is to be ignored
+
+    Exits (or throws exception; see throw_on_error()) if the record cannot be merged
+*/
+  template <mergeable T>
+  FCC_RECORD* target(const dat_record<T>& r);
+
+/*! \brief      Find or create the output record into which a record from a .DAT file is to be merged
+    \param  r   record to be merged
+    \return     pointer to the output record, or nullptr if <i>r</i> is to be ignored
+
+    The same as target(), except that the callsigns are not compared, so that the output record is not read.
+    Exits (or throws exception; see throw_on_error()) if the record is required to be in the file and is not
+*/
+  template <mergeable T>
+  FCC_RECORD* locate(const dat_record<T>& r);
+
+/*! \brief      Check that the callsign of a record from a .DAT file matches that of its output record, if merge_traits<T> require it
+    \param  rec output record
+    \param  r   record to be merged
+
+    Exits (or throws exception; see throw_on_error()) if the callsigns do not match
+*/
+  template <mergeable T>
+  void check_callsign(const FCC_RECORD& rec, const dat_record<T>& r) const;
+
+/*! \brief      Prefetch the parts of an output record that will be accessed when a record from a .DAT file is merged into it
+    \param  rec output record
+    \param  r   record to be merged (used only for its type)
+*/
+  template <mergeable T>
+  static inline void prefetch_fields(const FCC_RECORD& rec, const dat_record<T>& r)
+  { if constexpr (merge_traits<T>::check_callsign)
+      __builtin_prefetch(&rec.template get<FCC::CALLSIGN>());
+
+    prefetch_fields(rec, r, std::make_index_sequence<merge_traits<T>::fields.size()>());
+  }
+
+/// prefetch, for writing, every destination field in the mapping table for T
+  template <mergeable T, size_t... I>
+  static inline void prefetch_fields(const FCC_RECORD& rec, const dat_record<T>&, std::index_sequence<I...>)
+    { ( __builtin_prefetch(&rec.template get<merge_traits<T>::fields[I].dst>(), 1), ... ); }
+
+/*! \brief          Merge the fields of a record from a .DAT file into an output record
+    \param  rec     output record
+    \param  r       record to be merged
+*/
+  template <mergeable T>
+  static inline void merge_fields(FCC_RECORD& rec, const dat_record<T>& r)
+    { merge_fields(rec, r, std::make_index_sequence<merge_traits<T>::fields.size()>()); }
 
-/// add a range to the file  
+/*! \brief          Merge a single field of a record from a .DAT file into an output record
+    \param  rec     output record
+    \param  r       record to be merged
+
+    <i>M</i> is the entry in the mapping table for the field
+*/
+  template <auto M, mergeable T>
+  static inline void merge_field(FCC_RECORD& rec, const dat_record<T>& r)
+  { const std::string& src { r.template get<M.src>() };
+    std::string&       dst { rec.template get<M.dst>() };
+
+    if constexpr (M.transform == TRANSFORM::COPY)
+      dst = src;
+
+    if constexpr (M.transform == TRANSFORM::DATE)
+    { if (!src.empty())
+      { std::array<char, ISO_DATE_LENGTH> iso_date;
+
+        dst.assign(transform_date(src, iso_date));
+      }
+    }
+
+    if constexpr (M.transform == TRANSFORM::ID)
+    { if (dst.empty())
+        dst = src;
+    }
+  }
+
+/// merge all the fields in the mapping table for T; the compiler generates a straight-line sequence of merges
+  template <mergeable T, size_t... I>
+  static inline void merge_fields(FCC_RECORD& rec, const dat_record<T>& r, std::index_sequence<I...>)
+    { ( merge_field<merge_traits<T>::fields[I]>(rec, r), ... ); }
+
+/// the number of records that have been ignored because their IDs were not in the file
+  inline size_t n_orphans(void) const
+    { return _n_orphans; }
+
+/*! \brief      Add a range of records from a .DAT file to the file
+    \param  r   the records to add
+
+    If the records stay put while the range is traversed, they are merged in batches of MERGE_BATCH_SIZE:
+    the output records of the whole batch are located, and the fields that are to be written are prefetched,
+    before any record of the batch is merged. The lookups do not depend on one another, so their cache
+    misses overlap, and a record's output fields are normally in the cache by the time that it is merged.
+    Records of ranges such as dat_view, which re-use a single record, are merged one at a time
+*/
   template <std::ranges::range R>
-  inline void operator+=(R&& r)
-    { std::ranges::for_each(r, [this] (const auto& v) { (*this) += v; }); }
+  void operator+=(R&& r)
+  { using reference = std::ranges::range_reference_t<R>;
+
+    if constexpr (std::ranges::forward_range<R> and std::is_lvalue_reference_v<reference>)
+    { using record_type = std::remove_cvref_t<reference>;
+
+      std::array<const record_type*, MERGE_BATCH_SIZE> batch;
+      std::array<FCC_RECORD*, MERGE_BATCH_SIZE>        targets;
+      size_t                                           n_in_batch { 0 };
+
+      auto merge_batch { [&] (void)
+                           { for (size_t n = 0; n < n_in_batch; ++n)
+                               if (targets[n])
+                               { check_callsign(*targets[n], *batch[n]);
+                                 merge_fields(*targets[n], *batch[n]);
+                               }
+
+                             n_in_batch = 0;
+                           } };
+
+      for (const record_type& rec : r)
+      { batch[n_in_batch] = &rec;
+        targets[n_in_batch] = locate(rec);
+
+        if (targets[n_in_batch])
+          prefetch_fields(*targets[n_in_batch], rec);
+
+        if (++n_in_batch == MERGE_BATCH_SIZE)
+          merge_batch();
+      }
+
+      merge_batch();
+    }
+    else
+      std::ranges::for_each(r, [this] (const auto& v) { (*this) += v; });
+  }
  
 /// convert to a string
-  const std::string to_string(void) const;
+  inline const std::string to_string(void) const
+    { return to_string(ordered_records()); }
+
+/*! \brief          Convert some records to a string
+    \param  recs    the records to convert, in the order in which they are to appear
+    \return         <i>recs</i> as a string, one record per line
+*/
+  const std::string to_string(const std::vector<const FCC_RECORD*>& recs) const;
+
+/*! \brief              Get the records in output order
+    \param  duplicates  what to do with records that have the same call
+    \param  order       the order of the records
+    \return             pointers to the records, in the order <i>order</i>
+
+    In callsign order, the records are sorted once, after which the records of each call are adjacent, so that
+    duplicates are resolved in a single linear pass; a report is written to cerr if <i>duplicates</i> is REPORT.
+    In the other orders, duplicates are resolved with a table of the newest record of each call, and no
+    report is written; if <i>duplicates</i> is ALL, the records are not keyed, and in NONE order not even sorted
+*/
+  std::vector<const FCC_RECORD*> ordered_records(const DUPLICATES duplicates = DUPLICATES::NEWEST, const ORDER order = ORDER::CALLSIGN) const;
+
+/*! \brief              Write the records to one file per shard
+    \param  shard_by    how to divide the records amongst the shards
+    \param  directory   directory in which to write the files
+    \param  duplicates  what to do with records that have the same call
+    \param  order       the order of the records in each file
+    \return             the amount written to all the files
+
+    The files are named <i>shard</i>.txt; they are written in parallel
+*/
+  output_totals write_shards(const SHARD_BY shard_by, const std::string& directory, const DUPLICATES duplicates = DUPLICATES::NEWEST, const ORDER order = ORDER::CALLSIGN) const;
   
 /// eliminate invalid records
   void validate(void);
 };
 
+/*! \brief      Find or create the output record into which a record from a .DAT file is to be merged
+    \param  r   record to be merged
+    \return     pointer to the output record, or nullptr if <i>r</i> is to be ignored
+
+    The same as target(), except that the callsigns are not compared, so that the output record is not read.
+    Exits (or throws exception; see throw_on_error()) if the record is required to be in the file and is not
+*/
+template <mergeable T>
+FCC_RECORD* fcc_file::locate(const dat_record<T>& r)
+{ using traits = merge_traits<T>;
+
+  const std::string& key { r.template get<T::ID>() };
+
+  if constexpr (traits::missing_id == MISSING_ID::CREATE)
+    return &((*this)[key]);
+  else
+  { const auto it { find(key) };         // look to see if this key exists
+
+    if (it == end())
+    { if constexpr (traits::missing_id == MISSING_ID::FATAL)
+      { std::cerr << traits::name << " key " << key << " not in FCC file " << std::endl;
+        _merge_error();
+      }
+
+      _n_orphans++;
+      return nullptr;
+    }
+
+    return &(it->second);
+  }
+}
+
+/*! \brief      Check that the callsign of a record from a .DAT file matches that of its output record, if merge_traits<T> require it
+    \param  rec output record
+    \param  r   record to be merged
+
+    Exits (or throws exception; see throw_on_error()) if the callsigns do not match
+*/
+template <mergeable T>
+void fcc_file::check_callsign(const FCC_RECORD& rec, const dat_record<T>& r) const
+{ using traits = merge_traits<T>;
+
+  if constexpr (traits::check_callsign)           // treat a mismatch as a fatal error
+  { if (rec.template get<FCC::CALLSIGN>() != r.template get<T::CALLSIGN>())         // a string comparison is cheaper than building two keys
+    { std::cerr << traits::name << " callsign " << r.template get<T::CALLSIGN>() << " does not match callsign in FCC file: " << rec.template get<FCC::CALLSIGN>() << std::endl;
+      _merge_error();
+    }
+  }
+}
+
+/*! \brief      Get the output record into which a record from a .DAT file is to be merged
+    \param  r   record to be merged
+    \return     pointer to the output record, or nullptr if <i>r</i> is to be ignored
+
+    Exits (or throws exception; see throw_on_error()) if the record cannot be merged
+*/
+template <mergeable T>
+FCC_RECORD* fcc_file::target(const dat_record<T>& r)
+{ FCC_RECORD* rv { locate(r) };
+
+  if (rv)
+    check_callsign(*rv, r);
+
+  return rv;
+}
+
+/*! \brief      Add a record from a .DAT file to the file
+    \param  r   record to add
+
+    The merge is defined by merge_traits<T>
+*/
+template <mergeable T>
+void fcc_file::operator+=(const dat_record<T>& r)
+{ FCC_RECORD* rec_p { target(r) };
+
+  if (rec_p)
+    merge_fields(*rec_p, r);
+}
+
 #endif    // FCC_DB_H
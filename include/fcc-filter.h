@@ -0,0 +1,180 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+#ifndef FCC_FILTER_H
+#define FCC_FILTER_H
+
+/*! \file   fcc-filter.h
+
+    A compact membership filter (a binary fuse filter with 8-bit fingerprints) for callsigns.
+
+    See: T. M. Graf and D. Lemire, "Binary Fuse Filters: Fast and Smaller Than Xor Filters",
+    ACM Journal of Experimental Algorithmics, 27, 2022.
+
+    The filter uses about 9 bits per callsign and has a false-positive rate of about 0.4%;
+    there are no false negatives. Probing the filter requires only this file, so that
+    other programs can use it without linking against anything else.
+
+    A filter file comprises a callsign_filter_header followed by the fingerprints, in
+    native byte order
+*/
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr std::array<char, 8> CALLSIGN_FILTER_MAGIC { 'F', 'C', 'C', 'B', 'F', '8', '0', '1' };
+
+/// header of a filter file
+struct callsign_filter_header
+{ std::array<char, 8> magic                { CALLSIGN_FILTER_MAGIC };
+  uint64_t            seed                 { 0 };
+  uint32_t            segment_length       { 0 };
+  uint32_t            segment_length_mask  { 0 };
+  uint32_t            segment_count        { 0 };
+  uint32_t            segment_count_length { 0 };
+  uint32_t            array_length         { 0 };     ///< number of fingerprints
+  uint32_t            n_keys               { 0 };     ///< number of callsigns in the filter
+};
+
+/*! \brief          Hash a callsign to 64 bits (FNV-1a)
+    \param  call    callsign
+    \return         64-bit hash of <i>call</i>
+
+    This is part of the file format, so must not change
+*/
+inline uint64_t callsign_hash(const std::string_view call)
+{ uint64_t rv { 0xcbf29ce484222325 };
+
+  for (const char c : call)
+    rv = (rv ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+
+  return rv;
+}
+
+/// the finalising function from MurmurHash3
+inline uint64_t murmur64(uint64_t h)
+{ h ^= (h >> 33);
+  h *= 0xff51afd7ed558ccd;
+  h ^= (h >> 33);
+  h *= 0xc4ceb9fe1a85ec53;
+  h ^= (h >> 33);
+
+  return h;
+}
+
+/// the fingerprint associated with a mixed hash
+inline uint8_t filter_fingerprint(const uint64_t h)
+  { return static_cast<uint8_t>(h ^ (h >> 32)); }
+
+/*! \brief          Get the location of one of the three fingerprints associated with a mixed hash
+    \param  index   which of the three fingerprints (0, 1 or 2)
+    \param  h       mixed hash
+    \param  header  filter parameters
+    \return         location of fingerprint <i>index</i> for <i>h</i>
+*/
+inline uint32_t filter_location(const uint32_t index, const uint64_t h, const callsign_filter_header& header)
+{ uint64_t rv { static_cast<uint64_t>( (static_cast<unsigned __int128>(h) * header.segment_count_length) >> 64 ) };
+
+  rv += (index * header.segment_length);
+  rv ^= ( ( (h bitand ((1ULL << 36) - 1)) >> (36 - 18 * index) ) bitand header.segment_length_mask );
+
+  return static_cast<uint32_t>(rv);
+}
+
+// -----------  callsign_filter  ----------------
+
+/*!     \class callsign_filter
+        \brief a binary fuse filter of callsigns
+
+        The calls used to probe the filter should be in upper case, as in the FCC data
+*/
+
+class callsign_filter
+{
+protected:
+
+  callsign_filter_header _header;             ///< filter parameters
+  std::vector<uint8_t>   _fingerprints;       ///< the fingerprints
+
+public:
+
+/*! \brief          Construct from the contents of a filter file
+    \param  bytes   contents of a filter file
+
+    Throws std::invalid_argument if <i>bytes</i> is not a valid filter
+*/
+  explicit callsign_filter(const std::span<const uint8_t> bytes)
+  { if (bytes.size() < sizeof(_header))
+      throw std::invalid_argument("Callsign filter too short");
+
+    memcpy(&_header, bytes.data(), sizeof(_header));
+
+    if ( (_header.magic != CALLSIGN_FILTER_MAGIC) or (bytes.size() != sizeof(_header) + _header.array_length) )
+      throw std::invalid_argument("Invalid callsign filter");
+
+    _fingerprints.assign(bytes.begin() + sizeof(_header), bytes.end());
+  }
+
+/*! \brief              Construct from a filter file
+    \param  filename    name of filter file
+
+    Throws std::invalid_argument if the file cannot be read or is not a valid filter
+*/
+  explicit callsign_filter(const std::string& filename) :
+    callsign_filter(std::span<const uint8_t>(read_bytes(filename)))
+  { }
+
+/// read the contents of a file
+  static std::vector<uint8_t> read_bytes(const std::string& filename)
+  { std::ifstream ifs(filename, std::ios::binary);
+
+    if (!ifs)
+      throw std::invalid_argument("Cannot open callsign filter: " + filename);
+
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(ifs), { });
+  }
+
+/// number of calls in the filter
+  inline uint32_t size(void) const
+    { return _header.n_keys; }
+
+/*! \brief          Is a call (probably) in the filter?
+    \param  call    callsign to test
+    \return         false if <i>call</i> is definitely not in the filter; true otherwise
+*/
+  inline bool contains(const std::string_view call) const
+  { const uint64_t h { murmur64(callsign_hash(call) + _header.seed) };
+
+    return ( (filter_fingerprint(h) ^ _fingerprints[filter_location(0, h, _header)]
+                                    ^ _fingerprints[filter_location(1, h, _header)]
+                                    ^ _fingerprints[filter_location(2, h, _header)]) == 0 );
+  }
+};
+
+/*! \brief          Build a filter
+    \param  calls   callsigns to be included in the filter (duplicates are permitted)
+    \return         contents of a filter file containing <i>calls</i>
+*/
+std::vector<uint8_t> build_callsign_filter(const std::vector<std::string>& calls);
+
+/*! \brief              Build a filter and write it to a file
+    \param  filename    name of file to write
+    \param  calls       callsigns to be included in the filter (duplicates are permitted)
+
+    Throws exception if the file cannot be written
+*/
+void write_callsign_filter(const std::string& filename, const std::vector<std::string>& calls);
+
+#endif    // FCC_FILTER_H
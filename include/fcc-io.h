@@ -0,0 +1,44 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+#ifndef FCC_IO_H
+#define FCC_IO_H
+
+/*! \file   fcc-io.h
+
+    Reading several input files concurrently
+*/
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/// the ways in which input files may be read
+enum class READ_METHOD { AUTO = 0,            // io_uring if the kernel supports it; otherwise pread
+                         URING,               // io_uring; an error if the kernel does not support it
+                         PREAD                // one thread per file, each using pread
+                       };
+
+/*! \brief              Read several files concurrently
+    \param  filenames   names of the files to read
+    \param  fn          function to be called with the index into <i>filenames</i> and the contents of each file
+    \param  method      how to read the files
+
+    <i>fn</i> is called for each file as soon as that file has been read completely, so the
+    files are not necessarily processed in the order in which they appear in <i>filenames</i>;
+    <i>fn</i> might be called from more than one thread.
+
+    With io_uring, large reads of all the files are in flight at the same time, so that the
+    I/O is overlapped with whatever <i>fn</i> does with the files that have already been read.
+
+    Throws exception if a file does not exist, is a directory, or cannot be read, or if <i>method</i>
+    is URING and io_uring is not available
+*/
+void read_files(const std::vector<std::string>& filenames, const std::function<void(const size_t, std::string&&)>& fn, const READ_METHOD method = READ_METHOD::AUTO);
+
+#endif    // FCC_IO_H
@@ -0,0 +1,136 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+#ifndef FCC_LOCALITY_H
+#define FCC_LOCALITY_H
+
+/*! \file   fcc-locality.h
+
+    An index of the output by locality: state, ZIP code and city
+*/
+
+#include "fcc-db.h"
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* A locality index contains two tables of keys, each sorted, followed by the postings to which the keys refer.
+
+   The keys of the ZIP table are the state followed by the 5-digit ZIP code (for example, "WA98101"), so
+   that the records in a state, in a 3-digit ZIP prefix within the state and in a 5-digit ZIP code each
+   occupy a contiguous range of the table. The keys of the city table are the state, '|' and the city.
+
+   Each key refers to a contiguous range of postings, in ascending order of ID; a posting holds the ID of a
+   record and the byte offset of the record in the output. The file comprises a locality_index_header,
+   the ZIP keys, the city keys and the postings, in native byte order
+*/
+
+constexpr std::array<char, 8> LOCALITY_INDEX_MAGIC { 'F', 'C', 'C', 'L', 'O', 'C', '0', '1' };
+constexpr std::string_view    UNKNOWN_STATE        { "--" };                  ///< state used in keys when a record has none
+constexpr size_t              LOCALITY_KEY_LENGTH  { 32 };                    ///< maximum length of a key; longer keys are truncated
+constexpr size_t              LOCALITY_ZIP_LENGTH  { 5 };                     ///< number of digits of the ZIP code in a key
+
+/// header of a locality index
+struct locality_index_header
+{ std::array<char, 8> magic       { LOCALITY_INDEX_MAGIC };
+  uint64_t            n_zip_keys  { 0 };
+  uint64_t            n_city_keys { 0 };
+  uint64_t            n_postings  { 0 };
+};
+
+/// a key in a locality index
+struct locality_key_entry
+{ std::array<char, LOCALITY_KEY_LENGTH> key { };   ///< the key, padded with NULs (truncated if necessary)
+  uint64_t             first { 0 };                 ///< index of the first posting
+  uint64_t             count { 0 };                 ///< number of postings
+};
+
+/// a record in a locality index
+struct locality_posting
+{ uint64_t id     { 0 };                            ///< ID of the record
+  uint64_t offset { 0 };                            ///< byte offset of the record in the output
+};
+
+/*! \brief              Write a locality index
+    \param  filename    name of file to write
+    \param  recs        records, in the order in which they appear in the output
+
+    Throws exception if the file cannot be written
+*/
+void write_locality_index(const std::string& filename, const std::vector<const FCC_RECORD*>& recs);
+
+// -----------  locality_index  ----------------
+
+/*!     \class locality_index
+        \brief an output file and its locality index, both mapped into memory
+
+        The time taken by a query is proportional to the number of records found, plus a term
+        logarithmic in the size of the index for each state
+*/
+
+class locality_index
+{
+protected:
+
+  memory_mapped_file                   _text;         ///< the output file
+  memory_mapped_file                   _index;        ///< the locality index
+  std::span<const locality_key_entry>  _zip_keys;     ///< the ZIP table
+  std::span<const locality_key_entry>  _city_keys;    ///< the city table
+  std::span<const locality_posting>    _postings;     ///< the postings
+
+/*! \brief          The postings of the keys that start with a prefix
+    \param  keys    the table
+    \param  state   the state; empty means every state
+    \param  rest    the remainder of the prefix, after the state
+    \param  exact   whether the key must be the same as the prefix, rather than merely start with it
+    \return         the postings of the matching keys, in the order of the table
+
+    The prefix is truncated in the same way as the keys, so an exact match of a long prefix might be a
+    match of only its first LOCALITY_KEY_LENGTH characters
+*/
+  std::vector<locality_posting> _find(const std::span<const locality_key_entry> keys, const std::string& state, const std::string& rest, const bool exact) const;
+
+/*! \brief              The lines of the output that are referred to by some postings
+    \param  postings    the postings
+    \return             the lines, without the trailing LF
+*/
+  std::vector<std::string_view> _lines(const std::vector<locality_posting>& postings) const;
+
+public:
+
+/*! \brief                  Constructor
+    \param  text_filename   name of the output file
+    \param  index_filename  name of the locality index
+
+    Throws exception if either file cannot be mapped, or if the index is invalid
+*/
+  locality_index(const std::string& text_filename, const std::string& index_filename);
+
+/*! \brief              Find the records in a state or a ZIP code
+    \param  state       the state; empty means every state
+    \param  zip_prefix  the leading digits of the ZIP code; empty means every ZIP code
+    \return             the matching lines of the output, without the trailing LF
+
+    Only the first LOCALITY_ZIP_LENGTH digits of <i>zip_prefix</i> are used, so a ZIP+4 code matches its whole 5-digit ZIP code
+*/
+  inline std::vector<std::string_view> zip(const std::string& state, const std::string& zip_prefix) const
+    { return _lines(_find(_zip_keys, state, zip_prefix.substr(0, LOCALITY_ZIP_LENGTH), false)); }
+
+/*! \brief          Find the records in a city
+    \param  state   the state; empty means every state
+    \param  city    the city
+    \return         the matching lines of the output, without the trailing LF
+*/
+  std::vector<std::string_view> city(const std::string& state, const std::string& city) const;
+};
+
+#endif    // FCC_LOCALITY_H
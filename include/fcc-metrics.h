@@ -0,0 +1,67 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+#ifndef FCC_METRICS_H
+#define FCC_METRICS_H
+
+/*! \file   fcc-metrics.h
+
+    Metrics in the Prometheus text format, for the textfile collector of node_exporter
+*/
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// labels of a sample, as (name, value) pairs
+using metric_labels = std::vector<std::pair<std::string, std::string>>;
+
+// -----------  metrics_file  ----------------
+
+/*!     \class metrics_file
+        \brief a set of metrics, each of which may have several samples with different labels
+*/
+
+class metrics_file
+{
+protected:
+
+/// a metric and its samples
+  struct family
+  { std::string                                     help;       ///< description
+    std::string                                     type;       ///< "gauge" or "counter"
+    std::vector<std::pair<metric_labels, double>>   samples;    ///< the samples
+  };
+
+  std::map<std::string, family> _families;    ///< the metrics, keyed by name
+
+public:
+
+/*! \brief          Add a sample
+    \param  name    name of the metric
+    \param  type    type of the metric: "gauge" or "counter"
+    \param  help    description of the metric
+    \param  value   value of the sample
+    \param  labels  labels of the sample
+*/
+  void add(const std::string& name, const std::string& type, const std::string& help, const double value, const metric_labels& labels = { });
+
+/// the metrics in the text format
+  std::string to_string(void) const;
+
+/*! \brief              Write the metrics to a file, atomically
+    \param  filename    name of the file
+
+    The metrics are written to a temporary file in the same directory, which is then renamed,
+    so that a reader never sees a partial file. Throws exception on error
+*/
+  void write(const std::string& filename) const;
+};
+
+#endif    // FCC_METRICS_H
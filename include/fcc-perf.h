@@ -0,0 +1,87 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+#ifndef FCC_PERF_H
+#define FCC_PERF_H
+
+/*! \file   fcc-perf.h
+
+    Hardware performance counters for the calling thread, using perf_event_open
+*/
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/// the counters, in the order in which they are stored
+enum class PERF_COUNTER { CYCLES = 0,
+                          INSTRUCTIONS,
+                          CACHE_MISSES,
+                          BRANCH_MISSES,
+                          N_COUNTERS
+                        };
+
+constexpr size_t N_PERF_COUNTERS { static_cast<size_t>(PERF_COUNTER::N_COUNTERS) };
+
+/// the values of the counters over an interval
+struct perf_sample
+{ std::array<uint64_t, N_PERF_COUNTERS> values { };     ///< values, scaled if the counters were multiplexed
+  bool                                  valid  { false };
+
+/// the value of a counter
+  inline uint64_t operator[](const PERF_COUNTER pc) const
+    { return values[static_cast<size_t>(pc)]; }
+
+/// accumulate another sample
+  perf_sample& operator+=(const perf_sample& ps);
+};
+
+/*! \brief      Enable or disable the counters
+    \param  b   whether to enable the counters
+    \return     whether the counters are available
+
+    If the kernel does not permit access to the counters, a warning is written to stderr
+    and the counters remain disabled
+*/
+bool enable_perf_counters(const bool b = true);
+
+/// are the counters enabled?
+bool perf_counters_enabled(void);
+
+// -----------  perf_counters  ----------------
+
+/*!     \class perf_counters
+        \brief count events on the calling thread, from construction until read()
+
+        Does nothing unless the counters have been enabled
+*/
+
+class perf_counters
+{
+protected:
+
+  std::array<int, N_PERF_COUNTERS> _fds;        ///< one per counter; the first is the group leader, and is -1 if the counters are not active
+
+public:
+
+/// constructor; starts the counters
+  perf_counters(void);
+
+  perf_counters(const perf_counters&) = delete;
+  perf_counters& operator=(const perf_counters&) = delete;
+
+/// destructor; releases the counters
+  ~perf_counters(void);
+
+/*! \brief      The counts since construction
+    \return     the counts; invalid if the counters are not active
+*/
+  perf_sample read(void) const;
+};
+
+#endif    // FCC_PERF_H
@@ -0,0 +1,151 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+#ifndef FCC_PLAN_H
+#define FCC_PLAN_H
+
+/*! \file   fcc-plan.h
+
+    Plans for builds whose output contains only some of the fields, or only some of the records
+*/
+
+#include "fcc-db.h"
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*! \brief          Get the name of a field of the output
+    \param  field   the field
+    \return         the name of <i>field</i>, which is the same as that of the enumerator
+*/
+std::string_view fcc_field_name(const FCC field);
+
+/*! \brief          Get a field of the output from its name
+    \param  name    the name of the field, in any case
+    \return         the field called <i>name</i>
+
+    Exits if there is no such field
+*/
+FCC fcc_field(const std::string& name);
+
+// -----------  query_plan  ----------------
+
+/*!     \class query_plan
+        \brief which .DAT files and which of their fields must be read to produce a particular output
+
+        The output fields, and the fields named in the conditions, are traced back through the merge_traits
+        tables to the fields of the .DAT files from which they are merged. A .DAT file none of whose fields
+        is needed is not read at all, and the parsers keep only the fields that are needed. The AM and HD files
+        are always read: AM creates the records, and HD determines which of them have expired or been cancelled.
+        The fields that define the output order (the callsign, the last action date and the ID) are always built
+*/
+
+class query_plan
+{
+protected:
+
+  std::vector<FCC>                         _fields;       ///< the output fields, in order; empty means every field, in the usual order
+  std::vector<std::pair<FCC, std::string>> _where;        ///< the conditions, all of which a record must meet to be output
+  column_mask<FCC>                         _needed;       ///< the fields of the output that must be built
+
+/// does any field of <i>T</i> contribute to a needed field of the output?
+  template <mergeable T>
+  bool _contributes(void) const
+  { for (const auto& fm : merge_traits<T>::fields)
+      if (_needed.test(static_cast<size_t>(fm.dst)))
+        return true;
+
+    return false;
+  }
+
+public:
+
+/// constructor; the plan for the complete output
+  query_plan(void)
+    { _needed.set(); }
+
+/*! \brief          Constructor
+    \param  fields  comma-separated names of the output fields, in order; empty means every field
+    \param  where   comma-separated conditions of the form FIELD=VALUE, all of which a record must meet; empty means every record
+
+    Names of fields may be in any case; values are compared after conversion to upper case, as in the
+    records themselves. Dates are compared in the output format, YYYY-MM-DD. Exits if a field or a condition is invalid
+*/
+  query_plan(const std::string& fields, const std::string& where);
+
+/// does the output contain only some of the fields?
+  inline bool projected(void) const
+    { return !_fields.empty(); }
+
+/// does the output contain only some of the records?
+  inline bool filtered(void) const
+    { return !_where.empty(); }
+
+/// must a particular type of .DAT file be read?
+  template <mergeable T>
+  bool needs(void) const
+  { if constexpr ( (merge_traits<T>::missing_id == MISSING_ID::CREATE) or std::is_same_v<T, HD> )
+      return true;
+    else
+      return _contributes<T>();
+  }
+
+/// the fields of a particular type of .DAT file that must be kept when it is parsed
+  template <mergeable T>
+  column_mask<T> columns(void) const
+  { column_mask<T> rv;
+
+    rv.set(static_cast<size_t>(T::ID));                   // the key
+
+    if constexpr (merge_traits<T>::check_callsign)
+      rv.set(static_cast<size_t>(T::CALLSIGN));
+
+    if constexpr (std::is_same_v<T, HD>)                  // used to find the dead IDs
+    { rv.set(static_cast<size_t>(HD::EXPIRED_DATE));
+      rv.set(static_cast<size_t>(HD::CANCELLATION_DATE));
+    }
+
+    for (const auto& fm : merge_traits<T>::fields)
+      if (_needed.test(static_cast<size_t>(fm.dst)))
+        rv.set(static_cast<size_t>(fm.src));
+
+    return rv;
+  }
+
+/*! \brief      Does a record meet the conditions?
+    \param  rec the record
+    \return     whether <i>rec</i> meets every condition
+*/
+  bool selects(const FCC_RECORD& rec) const;
+
+/*! \brief      Select the records that meet the conditions
+    \param  recs    records, in output order
+    \return         the records in <i>recs</i> that meet every condition, in the same order
+*/
+  std::vector<const FCC_RECORD*> select(const std::vector<const FCC_RECORD*>& recs) const;
+
+/*! \brief          Append the output fields of a record to a string
+    \param  rec     the record
+    \param  str     the string to which the fields are appended, separated by "|"
+*/
+  void append_to(const FCC_RECORD& rec, std::string& str) const;
+
+/*! \brief          Convert some records to a string
+    \param  recs    the records to convert, in the order in which they are to appear
+    \return         the output fields of <i>recs</i>, one record per line
+*/
+  std::string to_string(const std::vector<const FCC_RECORD*>& recs) const;
+
+/// a one-line description of the plan, for --stats
+  std::string description(void) const;
+};
+
+#endif    // FCC_PLAN_H
@@ -0,0 +1,163 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+#ifndef FCC_PROFILE_H
+#define FCC_PROFILE_H
+
+/*! \file   fcc-profile.h
+
+    Profiles of the fields in FCC .DAT files: lengths, cardinalities and null rates
+*/
+
+#include "fcc-db.h"
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr unsigned HLL_PRECISION       { 14 };         ///< log2 of the number of registers in a HyperLogLog sketch; the standard error is about 0.8%
+constexpr size_t   PROFILE_LENGTH_BINS { 256 };        ///< lengths below this are counted exactly; longer lengths share a single bin
+
+// -----------  hyperloglog  ----------------
+
+/*!     \class hyperloglog
+        \brief estimate the number of distinct values in a stream, in constant space
+*/
+
+class hyperloglog
+{
+protected:
+
+  std::array<uint8_t, (1 << HLL_PRECISION)> _registers { };     ///< the largest rank seen by each register
+
+public:
+
+/*! \brief          Add a value
+    \param  str     the value
+*/
+  void add(const std::string_view str);
+
+/// the estimated number of distinct values added
+  double estimate(void) const;
+};
+
+// -----------  length_histogram  ----------------
+
+/*!     \class length_histogram
+        \brief the distribution of the lengths of a field
+*/
+
+class length_histogram
+{
+protected:
+
+  std::array<uint64_t, PROFILE_LENGTH_BINS + 1> _bins { };      ///< number of values of each length; the last bin holds all the longer values
+  uint64_t                                      _n    { 0 };    ///< number of values
+  size_t                                        _max  { 0 };    ///< the greatest length
+
+public:
+
+/// add a length
+  inline void add(const size_t len)
+  { _bins[std::min(len, PROFILE_LENGTH_BINS)]++;
+    _n++;
+    _max = std::max(_max, len);
+  }
+
+/// the number of values
+  inline uint64_t n(void) const
+    { return _n; }
+
+/// the greatest length
+  inline size_t max(void) const
+    { return _max; }
+
+/*! \brief      The length below or at which a proportion of the values lie
+    \param  q   the proportion, in the range [0, 1]
+    \return     the <i>q</i>th quantile of the lengths; if that falls in the last bin, the greatest length
+*/
+  size_t percentile(const double q) const;
+};
+
+/// the profile of a single field
+struct field_profile
+{ length_histogram lengths;                   ///< distribution of lengths
+  hyperloglog      distinct;                  ///< distinct values
+  uint64_t         n_empty      { 0 };        ///< number of empty values
+  uint64_t         n_line_feeds { 0 };        ///< number of values that contain a line feed
+};
+
+/// the profile of a .DAT file
+struct file_profile
+{ std::string                name;                    ///< name of the file
+  uint64_t                   n_records    { 0 };      ///< number of records
+  uint64_t                   n_multi_line { 0 };      ///< number of records that occupy more than one line
+  std::vector<field_profile> fields;                  ///< the profiles of the fields, in order
+};
+
+/*! \brief          Profile the records of a .DAT file
+    \param  name    name of the file
+    \param  dv      the records
+    \return         the profile of the fields of <i>dv</i>
+
+    The records are parsed one at a time, so the memory used does not depend on the size of the file
+*/
+template <typename T>
+file_profile profile_records(const std::string& name, dat_view<T> dv)
+{ file_profile rv { name, 0, 0, std::vector<field_profile>(static_cast<size_t>(T::N_FIELDS)) };
+
+  for (const dat_record<T>& rec : dv)
+  { bool multi_line { false };
+
+    rv.n_records++;
+
+    for (size_t n = 0; n < static_cast<size_t>(T::N_FIELDS); ++n)
+    { const std::string& value { rec.field(n) };
+      field_profile&     fp    { rv.fields[n] };
+
+      fp.lengths.add(value.size());
+      fp.distinct.add(value);
+
+      if (value.empty())
+        fp.n_empty++;
+
+      if (value.find("<LF>"s) != std::string::npos)     // line feeds are marked by dat_file
+      { fp.n_line_feeds++;
+        multi_line = true;
+      }
+    }
+
+    if (multi_line)
+      rv.n_multi_line++;
+  }
+
+  return rv;
+}
+
+/*! \brief              Profile a .DAT file
+    \param  fn          name of the file
+    \param  contents    contents of the file
+    \return             the profile of the fields of <i>fn</i>
+
+    The type of the records is taken from the first two characters of the name of the file. Throws
+    exception if the type is unknown
+*/
+file_profile profile_file(const std::string& fn, const std::string& contents);
+
+/*! \brief              Write profiles as tables
+    \param  ost         stream to which the tables are written
+    \param  profiles    the profiles
+
+    Fields are identified by their positions, as in the FCC's definitions of the .DAT files
+*/
+void print_profiles(std::ostream& ost, const std::vector<file_profile>& profiles);
+
+#endif    // FCC_PROFILE_H
@@ -0,0 +1,128 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+#ifndef FCC_SNAPSHOT_H
+#define FCC_SNAPSHOT_H
+
+/*! \file   fcc-snapshot.h
+
+    Binary snapshots of merged records.
+
+    A snapshot comprises a snapshot_header followed by the records, in the order defined by
+    compare_records(). Each record is stored as FCC::N_FIELDS fields, each of which is a
+    16-bit length followed by the contents of the field. All values are in native byte order
+*/
+
+#include "fcc-db.h"
+
+#include <fstream>
+#include <functional>
+#include <ostream>
+
+constexpr std::array<char, 8> SNAPSHOT_MAGIC { 'F', 'C', 'C', 'S', 'N', 'P', '0', '3' };    // 02: records of the same call are newest first; 03: calls in callsign_key order
+
+/// header of a snapshot
+struct snapshot_header
+{ std::array<char, 8> magic     { SNAPSHOT_MAGIC };
+  uint32_t            n_fields  { static_cast<uint32_t>(FCC::N_FIELDS) };
+  uint32_t            reserved  { 0 };
+  uint64_t            n_records { 0 };
+};
+
+// -----------  snapshot_writer  ----------------
+
+/*!     \class snapshot_writer
+        \brief write records to a snapshot, one at a time
+
+        The records must be added in the order defined by compare_records()
+*/
+
+class snapshot_writer
+{
+protected:
+
+  std::string     _filename;          ///< name of the snapshot file
+  std::ofstream   _ofs;               ///< stream for the snapshot file
+  snapshot_header _header;            ///< header, which is rewritten when the snapshot is closed
+  bool            _closed { false };  ///< has the snapshot been closed?
+
+public:
+
+/*! \brief              Constructor
+    \param  filename    name of the snapshot file
+
+    Throws exception if the file cannot be opened
+*/
+  explicit snapshot_writer(const std::string& filename);
+
+/// destructor; closes the snapshot if necessary
+  ~snapshot_writer(void);
+
+/*! \brief      Add a record to the snapshot
+    \param  rec record to be added
+
+    Throws exception if a field is too long to be stored
+*/
+  void operator+=(const FCC_RECORD& rec);
+
+/*! \brief  Complete the snapshot
+
+    Throws exception if the file cannot be written
+*/
+  void close(void);
+};
+
+// -----------  snapshot_reader  ----------------
+
+/*!     \class snapshot_reader
+        \brief read records from a snapshot, one at a time
+*/
+
+class snapshot_reader
+{
+protected:
+
+  memory_mapped_file _file;                   ///< the snapshot
+  size_t             _posn      { 0 };        ///< position of the next record
+  uint64_t           _remaining { 0 };        ///< number of records not yet read
+
+public:
+
+/*! \brief              Constructor
+    \param  filename    name of the snapshot file
+
+    Throws exception if the file cannot be mapped or is not a snapshot
+*/
+  explicit snapshot_reader(const std::string& filename);
+
+/*! \brief      Read the next record
+    \param  rec destination for the record
+    \return     whether a record was read
+
+    Throws exception if the snapshot is truncated
+*/
+  bool next(FCC_RECORD& rec);
+};
+
+/*! \brief              Write records to a snapshot
+    \param  filename    name of the snapshot file
+    \param  recs        the records, in the order defined by compare_records()
+*/
+void write_snapshot(const std::string& filename, const std::vector<const FCC_RECORD*>& recs);
+
+/*! \brief              Merge snapshots
+    \param  filenames   names of the snapshot files
+    \param  fn          function to be called for each record, in the order defined by compare_records()
+    \param  duplicates  what to do with records that have the same call
+
+    The snapshots may be the result of building different ranges of IDs; the records passed to <i>fn</i>
+    are the same as would have been output by a single build with the same value of <i>duplicates</i>
+*/
+void combine_snapshots(const std::vector<std::string>& filenames, const std::function<void(const FCC_RECORD&)>& fn, const DUPLICATES duplicates = DUPLICATES::NEWEST);
+
+#endif    // FCC_SNAPSHOT_H
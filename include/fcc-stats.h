@@ -0,0 +1,138 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+#ifndef FCC_STATS_H
+#define FCC_STATS_H
+
+/*! \file   fcc-stats.h
+
+    Timing and throughput of the stages of processing
+*/
+
+#include "fcc-alloc.h"
+#include "fcc-perf.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// the result of a completed stage
+struct stage_result
+{ std::string name;                   ///< name of the stage
+  double      wall_seconds  { 0 };    ///< elapsed time
+  double      cpu_seconds   { 0 };    ///< CPU time consumed by the thread that executed the stage
+  uint64_t    bytes         { 0 };    ///< number of bytes processed
+  uint64_t    records       { 0 };    ///< number of records processed
+  long        rss_delta_kib { 0 };    ///< increase in the peak resident set size of the process during the stage
+  perf_sample perf;                   ///< hardware counters for the thread that executed the stage, if they are enabled
+  alloc_counts allocs;                ///< allocations by the thread that executed the stage, if tracking is enabled; peak_bytes is relative to the start of the stage
+};
+
+// -----------  stage_timer  ----------------
+
+/*!     \class stage_timer
+        \brief measure a stage of processing, from construction until stop() or destruction
+
+        A stage is assumed to execute on a single thread. The results of all stages are
+        recorded, whether or not statistics have been enabled
+*/
+
+class stage_timer
+{
+protected:
+
+  std::string                           _name;                      ///< name of the stage
+  std::chrono::steady_clock::time_point _start;                     ///< wall time at the start
+  std::chrono::steady_clock::time_point _last_progress;             ///< wall time of the last progress report
+  double                                _cpu_start      { 0 };      ///< thread CPU time at the start
+  long                                  _rss_start      { 0 };      ///< peak RSS at the start
+  uint64_t                              _bytes          { 0 };      ///< number of bytes processed
+  uint64_t                              _records        { 0 };      ///< number of records processed
+  uint64_t                              _ticks          { 0 };      ///< number of records completed, for stages whose records are added in advance
+  bool                                  _stopped        { false };  ///< has the stage been stopped?
+  perf_counters                         _perf;                      ///< hardware counters for the thread
+  alloc_counts                          _allocs_start;              ///< allocations by the thread at the start
+  int64_t                               _outer_peak     { 0 };      ///< peak live bytes of the thread before the start, restored when the stage stops
+
+public:
+
+/*! \brief          Constructor; starts the stage
+    \param  name    name of the stage
+*/
+  explicit stage_timer(const std::string& name);
+
+  stage_timer(const stage_timer&) = delete;
+  stage_timer& operator=(const stage_timer&) = delete;
+
+/// destructor; stops the stage if necessary
+  inline ~stage_timer(void)
+    { stop(); }
+
+/*! \brief              Add to the amount of work done during the stage
+    \param  n_bytes     number of bytes
+    \param  n_records   number of records
+*/
+  inline void add(const uint64_t n_bytes, const uint64_t n_records = 0)
+  { _bytes += n_bytes;
+    _records += n_records;
+  }
+
+/*! \brief              Note that a record has been processed, and occasionally report progress
+    \param  n_bytes     number of bytes in the record
+
+    Progress is reported to stderr at most every few seconds, and only if statistics have been enabled
+*/
+  inline void record(const uint64_t n_bytes = 0)
+  { add(n_bytes, 1);
+
+    if ( (_records % 65'536) == 0 )
+      progress();
+  }
+
+/*! \brief  Note that one of the records that were added in advance has been completed, and occasionally report progress
+
+    Progress is reported to stderr at most every few seconds, and only if statistics have been enabled
+*/
+  inline void tick(void)
+  { if ( (++_ticks % 65'536) == 0 )
+      progress();
+  }
+
+/// report progress if statistics have been enabled and it is time to do so
+  void progress(void);
+
+/// stop the stage and record its result; does nothing if the stage has already been stopped
+  void stop(void);
+};
+
+/// enable or disable the reporting of statistics
+void enable_stats(const bool b = true);
+
+/// have statistics been enabled?
+bool stats_enabled(void);
+
+/// the results of all completed stages, in the order in which they completed
+std::vector<stage_result> stage_results(void);
+
+/// discard the results of all completed stages
+void clear_stage_results(void);
+
+/// the peak resident set size of the process, in KiB
+long peak_rss_kib(void);
+
+/// the CPU time consumed by the calling thread, in seconds
+double thread_cpu_seconds(void);
+
+/*! \brief      Print a table of the results of all completed stages
+    \param  ost stream to which the table is written
+*/
+void print_stats(std::ostream& ost);
+
+#endif    // FCC_STATS_H
@@ -16,8 +16,19 @@
     Functions related to the manipulation of strings
 */
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <compare>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using namespace std::string_literals;
@@ -29,6 +40,17 @@ using namespace std::string_literals;
 */
 std::vector<std::string> split_string(const std::string& cs, const std::string& separator);
 
+/*! \brief              Split a string into components, without allocating
+    \param  sv          original string
+    \param  separator   separator character
+    \param  fields      storage for the components, which refer to <i>sv</i>
+    \return             the number of components in <i>sv</i>
+
+    If <i>sv</i> has more components than <i>fields</i> can hold, only the first <i>fields.size()</i> are stored.
+    Unlike the other split_string(), a trailing separator implies an empty final component
+*/
+size_t split_string(const std::string_view sv, const char separator, const std::span<std::string_view> fields);
+
 /*! \brief              Read the contents of a file into a single string
     \param  filename    name of file to be read
     \return             contents of file <i>filename</i>
@@ -38,6 +60,15 @@ std::vector<std::string> split_string(const std::string& cs, const std::string&
 */
 std::string read_file(const std::string& filename);
 
+/*! \brief              Write a string to a file, atomically
+    \param  filename    name of file to be written
+    \param  contents    the string to write
+
+    The string is written to a temporary file in the same directory, which is then renamed,
+    so that a reader never sees a partial file. Throws exception on error
+*/
+void write_file_atomically(const std::string& filename, const std::string_view contents);
+
 /*! \brief                  Remove all instances of a particular char from a string
     \param  cs              original string
     \param  char_to_remove  character to be removed from <i>cs</i>
@@ -45,6 +76,13 @@ std::string read_file(const std::string& filename);
 */
 std::string remove_char(const std::string& cs, const char char_to_remove);
 
+/*! \brief                  Remove all instances of a particular char from a string, in place
+    \param  str             string to be modified
+    \param  char_to_remove  character to be removed from <i>str</i>
+*/
+inline void remove_char_in_place(std::string& str, const char char_to_remove)
+  { std::erase(str, char_to_remove); }
+
 /*! \brief              Split a string into lines
     \param  cs          original string
     \param  eol_marker  EOL marker
@@ -53,16 +91,39 @@ std::string remove_char(const std::string& cs, const char char_to_remove);
 inline std::vector<std::string> to_lines(const std::string& cs)
   { return split_string(cs, "\n"s); }
 
+constexpr size_t NUMBER_BUFFER_LENGTH { 20 };       ///< enough for any 64-bit integer, including the sign
+
+/*! \brief          Format an integer into a buffer
+    \param  val     value to format
+    \param  buffer  storage for the result
+    \return         <i>val</i> in decimal, in <i>buffer</i>; empty if <i>buffer</i> is too short
+*/
+template <std::integral T>
+inline std::string_view format_number(const T val, const std::span<char> buffer)
+{ const auto [ end_p, ec ] { std::to_chars(buffer.data(), buffer.data() + buffer.size(), val) };
+
+  return ( (ec == std::errc()) ? std::string_view(buffer.data(), end_p) : std::string_view() );
+}
+
 /*! \brief          Generic conversion to string
     \param  val     value to convert
     \return         <i>val</i>converted to a string
+
+    Integers are formatted with std::to_chars; single-octet types (bool and the chars) go through a stream, as do all other types
 */
 template <class T>
 std::string to_string(const T val)
-{ std::ostringstream stream;
-                
-  stream << val;
-  return stream.str();
+{ if constexpr (std::integral<T> and (sizeof(T) > 1))
+  { std::array<char, NUMBER_BUFFER_LENGTH> buffer;
+
+    return std::string(format_number(val, buffer));
+  }
+  else
+  { std::ostringstream stream;
+
+    stream << val;
+    return stream.str();
+  }
 }
 
 /*! \brief      Transform a string
@@ -72,20 +133,67 @@ std::string to_string(const T val)
 */
 std::string transform_string(const std::string& cs, int(*pf)(int));
 
+/*! \brief      Transform a string, in place
+    \param  str string to be modified
+    \param  pf  pointer to transformation function
+*/
+void transform_in_place(const std::span<char> str, int(*pf)(int));
+
 /*! \brief      Convert string to upper case
     \param  cs  original string
-    \return     <i>cs</i> converted to upper case
+    \return     <i>cs</i> with the ASCII letters and the UTF-8 Latin-1 letters converted to upper case
+
+    Other octets are left unchanged, so that UTF-8 sequences are preserved (std::toupper
+    is undefined for negative values of char)
 */
-inline std::string to_upper(const std::string& cs)
-  { return transform_string(cs, std::toupper); }
+std::string to_upper(const std::string& cs);
 
-/*! \brief      Transform an FCC date to an ISO 8601 extended-format date
-    \param  cs  original string
-    \param  pf  pointer to transformation function
-    \return     <i>cs</i> with the transformation <i>*pf</i> applied
+/*! \brief      Convert string to upper case, in place
+    \param  str string to be modified
+
+    The conversion is the same as that performed by to_upper()
+*/
+void to_upper_in_place(const std::span<char> str);
+
+/*! \brief      Is a string pure ASCII?
+    \param  sv  string to test
+    \return     whether every octet in <i>sv</i> is less than 0x80
+
+    Tests 16 octets at a time
+*/
+bool is_ascii(const std::string_view sv);
+
+/*! \brief      Is a string valid UTF-8?
+    \param  sv  string to test
+    \return     whether <i>sv</i> is valid UTF-8
+
+    Overlong encodings, surrogates and code points above U+10FFFF are invalid. Runs of ASCII are skipped 16 octets at a time
+*/
+bool is_valid_utf8(const std::string_view sv);
+
+/*! \brief      Repair a string that is not valid UTF-8
+    \param  sv  original string
+    \return     <i>sv</i>, with each octet that is not part of a valid UTF-8 sequence transcoded from CP1252 to UTF-8
+
+    CP1252 is a superset of the printable characters of Latin-1; the five octets that it leaves undefined become U+FFFD
+*/
+std::string repair_utf8(const std::string_view sv);
+
+constexpr size_t ISO_DATE_LENGTH { 10 };            ///< length of YYYY-MM-DD
+
+/*! \brief              Transform an FCC date to an ISO 8601 extended-format date
+    \param  us_date     original date, as MM/DD/YYYY
+    \return             <i>us_date</i> as YYYY-MM-DD
 */
 std::string transform_date(const std::string& us_date);
 
+/*! \brief              Transform an FCC date to an ISO 8601 extended-format date, in a buffer
+    \param  us_date     original date, as MM/DD/YYYY
+    \param  iso_date    storage for the result
+    \return             <i>us_date</i> as YYYY-MM-DD, in <i>iso_date</i>
+*/
+std::string_view transform_date(const std::string_view us_date, const std::span<char, ISO_DATE_LENGTH> iso_date);
+
 /*! \brief          Is one call earlier than another, according to classical callsign sort order?
     \param  call1   first call
     \param  call2   second call
@@ -93,6 +201,129 @@ std::string transform_date(const std::string& us_date);
 */
 bool compare_calls(const std::string& call1, const std::string& call2);
 
+/*! \brief      Is one FCC ID (unique system identifier) numerically less than another?
+    \param  id1 first ID
+    \param  id2 second ID
+    \return     whether <i>id1</i> is numerically less than <i>id2</i>
+
+    The IDs are assumed to be strings of decimal digits, without leading zeroes
+*/
+inline bool compare_ids(const std::string& id1, const std::string& id2)
+  { return ( (id1.size() != id2.size()) ? (id1.size() < id2.size()) : (id1 < id2) ); }
+
+/*! \brief          Get the prefix of a call
+    \param  call    callsign
+    \return         the leading letters of <i>call</i> followed by the digits that follow them
+
+    For example, "KL7" for KL7ABC. Returns the empty string if <i>call</i> is empty
+*/
+std::string callsign_prefix(const std::string& call);
+
+// -----------  callsign_key  ----------------
+
+constexpr size_t CALLSIGN_KEY_LENGTH { 15 };        ///< the greatest length of a call that a callsign_key represents exactly
+
+/* the octet that represents each character of a call in a callsign_key. The order of the octets is
+   the callsign sort order of compare_calls(): letters, then the digits 1 to 9, then 0, with '/' after
+   everything else. compare_calls() is not a consistent order for other characters, so they are simply
+   placed in ASCII order, those below 'Z' before the digits and the rest after them. Every character
+   has a different, non-zero, octet
+*/
+constexpr std::array<uint8_t, 256> CALLSIGN_KEY_CODES { [] (void)
+                                                          { std::array<uint8_t, 256> rv { };
+
+                                                            uint8_t code { 1 };
+
+                                                            for (int c = 1; c <= 'Z'; ++c)
+                                                              if ( ((c < '0') or (c > '9')) and (c != '/') )
+                                                                rv[c] = code++;
+
+                                                            for (const char c : { '1', '2', '3', '4', '5', '6', '7', '8', '9', '0' })
+                                                              rv[static_cast<uint8_t>(c)] = code++;
+
+                                                            for (int c = 'Z' + 1; c < 256; ++c)
+                                                              rv[c] = code++;
+
+                                                            rv['/'] = code;                   // 255
+
+                                                            return rv;
+                                                          } () };
+
+static_assert( (CALLSIGN_KEY_CODES['A'] < CALLSIGN_KEY_CODES['Z']) and (CALLSIGN_KEY_CODES['Z'] < CALLSIGN_KEY_CODES['1']) and
+               (CALLSIGN_KEY_CODES['9'] < CALLSIGN_KEY_CODES['0']) and (CALLSIGN_KEY_CODES['0'] < CALLSIGN_KEY_CODES['/']) and (CALLSIGN_KEY_CODES['/'] == 0xFF) );
+
+/*!     \class callsign_key
+        \brief a call packed into 16 octets, whose order is callsign sort order
+
+        Each character is replaced by its octet in CALLSIGN_KEY_CODES, and the result is padded with zeroes,
+        so that a call sorts before any longer call that it begins; the 16 octets are held as two
+        integers, most significant octet first, so that equality and order are each a single 128-bit comparison.
+
+        A call of up to CALLSIGN_KEY_LENGTH characters is represented exactly: two such keys are equal
+        if and only if the calls are the same, and are in the order defined by compare_calls(). A longer
+        call is truncated, and the last octet of its key is set, so that it follows every shorter call with
+        the same beginning; such keys are not exact(), and calls that share a key must be compared as strings
+*/
+
+class callsign_key
+{
+protected:
+
+  uint64_t _hi { 0 };                               ///< the first eight octets, most significant first
+  uint64_t _lo { 0 };                               ///< the last eight octets, most significant first
+
+public:
+
+/// default constructor; the key of the empty call
+  callsign_key(void) = default;
+
+/*! \brief      Constructor
+    \param  call    the call, which must not contain NUL
+*/
+  explicit callsign_key(const std::string_view call)
+  { std::array<uint8_t, 16> octets { };
+
+    const size_t n_chars { std::min(call.size(), CALLSIGN_KEY_LENGTH) };
+
+    for (size_t n = 0; n < n_chars; ++n)
+      octets[n] = CALLSIGN_KEY_CODES[static_cast<uint8_t>(call[n])];
+
+    if (call.size() > CALLSIGN_KEY_LENGTH)
+      octets[15] = 0xFF;
+
+    memcpy(&_hi, octets.data(), sizeof(_hi));
+    memcpy(&_lo, octets.data() + sizeof(_hi), sizeof(_lo));
+
+    if constexpr (std::endian::native == std::endian::little)
+    { _hi = std::byteswap(_hi);
+      _lo = std::byteswap(_lo);
+    }
+  }
+
+/// does the key represent the call exactly?
+  inline bool exact(void) const
+    { return !(_lo & 0xFF); }
+
+/// the order of two keys
+  std::strong_ordering operator<=>(const callsign_key&) const = default;
+
+/// are two keys equal?
+  bool operator==(const callsign_key&) const = default;
+
+/// a hash of the key
+  inline size_t hash(void) const
+  { uint64_t h { (_hi ^ std::rotl(_lo, 29)) * 0x9E3779B97F4A7C15ULL };      // std::hash<uint64_t> is usually the identity
+
+    return (h ^ (h >> 32));
+  }
+};
+
+template <>
+struct std::hash<callsign_key>
+{ inline size_t operator()(const callsign_key& key) const
+    { return key.hash(); }
+};
+
 /*! \brief  Create a string of a certain length, with all characters the same
     \param  c   Character that the string will contain
     \param  n   Length of string to be created
@@ -136,7 +367,145 @@ inline std::string remove_trailing_spaces(const std::string& cs)
 inline std::string remove_peripheral_spaces(const std::string& cs)
   { return remove_trailing_spaces(remove_leading_spaces(cs)); }
 
+/*! \brief      Skip all instances of a specific leading character
+    \param  sv  original string
+    \param  c   leading character to skip (if present)
+    \return     the part of <i>sv</i> that follows any leading octets with the value <i>c</i>
+*/
+inline std::string_view trim_leading(const std::string_view sv, const char c)
+{ const size_t posn { sv.find_first_not_of(c) };
+
+  return ( (posn == std::string_view::npos) ? sv.substr(sv.size()) : sv.substr(posn) );     // the string might contain nothing but c
+}
+
+/*! \brief      Skip all instances of a specific trailing character
+    \param  sv  original string
+    \param  c   trailing character to skip (if present)
+    \return     the part of <i>sv</i> that precedes any trailing octets with the value <i>c</i>
+*/
+inline std::string_view trim_trailing(const std::string_view sv, const char c)
+{ const size_t posn { sv.find_last_not_of(c) };
+
+  return ( (posn == std::string_view::npos) ? sv.substr(0, 0) : sv.substr(0, posn + 1) );
+}
+
+/*! \brief      Skip leading and trailing spaces
+    \param  sv  original string
+    \return     the part of <i>sv</i> between any leading and trailing spaces
+*/
+inline std::string_view trim_spaces(const std::string_view sv)
+  { return trim_trailing(trim_leading(sv, ' '), ' '); }
+
 /// return the current date as YYYY-MM-DD
 std::string date_string(void);
 
+// -----------  memory_mapped_file  ----------------
+
+/*!     \class memory_mapped_file
+        \brief a read-only file mapped into memory
+*/
+
+class memory_mapped_file
+{
+protected:
+
+  const char* _data { nullptr };      ///< start of the mapped contents
+  size_t      _size { 0 };            ///< length of the mapped contents
+
+public:
+
+/*! \brief              Constructor
+    \param  filename    name of file to be mapped
+
+    Throws exception if the file cannot be opened or mapped
+*/
+  explicit memory_mapped_file(const std::string& filename);
+
+  memory_mapped_file(const memory_mapped_file&) = delete;
+  memory_mapped_file& operator=(const memory_mapped_file&) = delete;
+
+/// destructor
+  ~memory_mapped_file(void);
+
+/// the contents of the file
+  inline std::string_view contents(void) const
+    { return std::string_view(_data, _size); }
+
+/// the size of the file
+  inline size_t size(void) const
+    { return _size; }
+};
+
+// -----------  sidecar offset index  ----------------
+
+/* A sidecar index samples the callsign-ordered output every OFFSET_INDEX_STRIDE records,
+   recording the key of the callsign and the byte offset of the record in the output. The file comprises
+   an offset_index_header followed by the entries, in native byte order
+*/
+
+constexpr std::array<char, 8> OFFSET_INDEX_MAGIC  { 'F', 'C', 'C', 'I', 'D', 'X', '0', '2' };    // 02: the keys are callsign_keys
+constexpr size_t              OFFSET_INDEX_STRIDE { 64 };                                       ///< number of records per sample
+
+/// header of a sidecar offset index
+struct offset_index_header
+{ std::array<char, 8> magic     { OFFSET_INDEX_MAGIC };
+  uint32_t            stride    { OFFSET_INDEX_STRIDE };
+  uint32_t            reserved  { 0 };
+  uint64_t            n_entries { 0 };
+};
+
+/// a single sample in a sidecar offset index
+struct offset_index_entry
+{ callsign_key         key;                           ///< key of the callsign
+  uint64_t             offset { 0 };                  ///< byte offset of the record in the output
+};
+
+/*! \brief          Create an index entry
+    \param  call    callsign
+    \param  offset  byte offset of the record whose callsign is <i>call</i>
+    \return         the index entry for <i>call</i> at <i>offset</i>
+*/
+offset_index_entry make_offset_index_entry(const std::string& call, const uint64_t offset);
+
+/*! \brief              Write a sidecar offset index
+    \param  filename    name of file to write
+    \param  entries     the samples, in callsign order
+
+    Throws exception if the file cannot be written
+*/
+void write_offset_index(const std::string& filename, const std::vector<offset_index_entry>& entries);
+
+// -----------  indexed_file  ----------------
+
+/*!     \class indexed_file
+        \brief an output file and its sidecar offset index, both mapped into memory
+*/
+
+class indexed_file
+{
+protected:
+
+  memory_mapped_file                   _text;        ///< the output file
+  memory_mapped_file                   _index;       ///< the sidecar index
+  std::span<const offset_index_entry>  _entries;     ///< the samples in the index
+
+public:
+
+/*! \brief                  Constructor
+    \param  text_filename   name of the output file
+    \param  index_filename  name of the sidecar index
+
+    Throws exception if either file cannot be mapped, or if the index is invalid
+*/
+  indexed_file(const std::string& text_filename, const std::string& index_filename);
+
+/*! \brief          Find the record for a particular call
+    \param  call    callsign to find
+    \return         the line in the output file for <i>call</i>, without the trailing LF
+
+    Returns the empty string if <i>call</i> is not present
+*/
+  std::string_view record(const std::string& call) const;
+};
+
 #endif    // FCC_STRINGS_H
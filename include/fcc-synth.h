@@ -0,0 +1,194 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+#ifndef FCC_SYNTH_H
+#define FCC_SYNTH_H
+
+/*! \file   fcc-synth.h
+
+    Synthetic .DAT records, with realistic distributions of calls, names, places and dates.
+
+    The records depend only on the seed, and not on the platform or the standard library
+*/
+
+#include <cstdint>
+#include <string>
+
+// -----------  synth_rng  ----------------
+
+/*!     \class synth_rng
+        \brief a small, fast, portable pseudo-random number generator (splitmix64)
+*/
+
+class synth_rng
+{
+protected:
+
+  uint64_t _state;                    ///< the state
+
+public:
+
+/*! \brief          Constructor
+    \param  seed    initial state
+*/
+  explicit synth_rng(const uint64_t seed) :
+    _state(seed)
+  { }
+
+/// the next 64-bit value
+  inline uint64_t next(void)
+  { uint64_t z { (_state += 0x9e3779b97f4a7c15ULL) };
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+    return z ^ (z >> 31);
+  }
+
+/*! \brief      A value in the range [0, n)
+    \param  n   upper bound (exclusive); must be greater than zero
+
+    Uses the multiply-shift range reduction rather than std::uniform_int_distribution, whose
+    results are not specified by the standard
+*/
+  inline uint64_t below(const uint64_t n)
+    { return static_cast<uint64_t>( (static_cast<unsigned __int128>(next()) * n) >> 64 ); }
+
+/*! \brief      A value in the range [lo, hi]
+    \param  lo  lower bound
+    \param  hi  upper bound
+*/
+  inline uint64_t between(const uint64_t lo, const uint64_t hi)
+    { return lo + below(hi - lo + 1); }
+
+/*! \brief      Return true with a given probability
+    \param  p   probability
+*/
+  inline bool chance(const double p)
+    { return (next() >> 11) * 0x1.0p-53 < p; }
+};
+
+/// a range of lengths; an empty range (the default) means that the natural length is used
+struct length_range
+{ size_t lo { 0 };
+  size_t hi { 0 };
+
+/// is the range empty?
+  inline bool empty(void) const
+    { return (hi == 0); }
+};
+
+/// the lengths of the free-text fields
+struct synth_lengths
+{ length_range name;              ///< names of entities and trustees
+  length_range address;           ///< street addresses
+  length_range comment;           ///< comments, attachment descriptions and free-form conditions
+};
+
+/*! \brief      A random call, with the distribution of formats found among amateur calls
+    \param  rng the generator
+    \return     a call such as "K7ABC" or "AA2X"
+*/
+std::string synth_callsign(synth_rng& rng);
+
+/*! \brief          A random date, as used in .DAT files
+    \param  rng     the generator
+    \param  year_lo earliest year
+    \param  year_hi latest year
+    \return         a date in the format MM/DD/YYYY
+*/
+std::string synth_date(synth_rng& rng, const int year_lo, const int year_hi);
+
+/*! \brief          Lengthen or shorten some text to a random length
+    \param  rng     the generator
+    \param  text    original text
+    \param  range   range of lengths
+    \return         <i>text</i>, truncated or extended with words to a length in <i>range</i>; <i>text</i> if <i>range</i> is empty
+*/
+std::string fit_length(synth_rng& rng, const std::string& text, const length_range& range);
+
+/*! \brief          Insert a line feed into a field of a record, as the FCC sometimes does
+    \param  rng     the generator
+    \param  line    the record
+    \param  field   index of the field
+    \return         <i>line</i> with a line feed inside field number <i>field</i>; <i>line</i> if the field has fewer than two characters
+*/
+std::string embed_line_feed(synth_rng& rng, const std::string& line, const size_t field);
+
+/*! \brief          An AM (amateur) record
+    \param  rng     the generator
+    \param  id      ID of the record
+    \param  cs      call
+    \param  lengths lengths of the free-text fields
+    \return         the record, without a terminating EOL
+*/
+std::string synth_am_line(synth_rng& rng, const uint64_t id, const std::string& cs, const synth_lengths& lengths = { });
+
+/*! \brief          A CO (comment) record
+    \param  rng     the generator
+    \param  id      ID of the record
+    \param  cs      call
+    \param  lengths lengths of the free-text fields
+    \return         the record, without a terminating EOL
+*/
+std::string synth_co_line(synth_rng& rng, const uint64_t id, const std::string& cs, const synth_lengths& lengths = { });
+
+/*! \brief          An EN (entity) record
+    \param  rng     the generator
+    \param  id      ID of the record
+    \param  cs      call
+    \param  lengths lengths of the free-text fields
+    \return         the record, without a terminating EOL
+*/
+std::string synth_en_line(synth_rng& rng, const uint64_t id, const std::string& cs, const synth_lengths& lengths = { });
+
+/*! \brief              An HD (header) record
+    \param  rng         the generator
+    \param  id          ID of the record
+    \param  cs          call
+    \param  expired     whether the licence has expired
+    \param  cancelled   whether the licence has been cancelled
+    \return             the record, without a terminating EOL
+*/
+std::string synth_hd_line(synth_rng& rng, const uint64_t id, const std::string& cs, const bool expired, const bool cancelled);
+
+/*! \brief      An HS (history) record
+    \param  rng the generator
+    \param  id  ID of the record
+    \param  cs  call
+    \return     the record, without a terminating EOL
+*/
+std::string synth_hs_line(synth_rng& rng, const uint64_t id, const std::string& cs);
+
+/*! \brief          An LA (licence attachment) record
+    \param  rng     the generator
+    \param  id      ID of the record
+    \param  cs      call
+    \param  lengths lengths of the free-text fields
+    \return         the record, without a terminating EOL
+*/
+std::string synth_la_line(synth_rng& rng, const uint64_t id, const std::string& cs, const synth_lengths& lengths = { });
+
+/*! \brief      An SC (special condition) record
+    \param  rng the generator
+    \param  id  ID of the record
+    \param  cs  call
+    \return     the record, without a terminating EOL
+*/
+std::string synth_sc_line(synth_rng& rng, const uint64_t id, const std::string& cs);
+
+/*! \brief          An SF (free-form special condition) record
+    \param  rng     the generator
+    \param  id      ID of the record
+    \param  cs      call
+    \param  lengths lengths of the free-text fields
+    \return         the record, without a terminating EOL
+*/
+std::string synth_sf_line(synth_rng& rng, const uint64_t id, const std::string& cs, const synth_lengths& lengths = { });
+
+#endif    // FCC_SYNTH_H
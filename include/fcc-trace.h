@@ -0,0 +1,90 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+#ifndef FCC_TRACE_H
+#define FCC_TRACE_H
+
+/*! \file   fcc-trace.h
+
+    Spans of execution on each thread, written as Chrome trace-event JSON, which may be
+    viewed with Perfetto or chrome://tracing.
+
+    Each thread records its spans in its own fixed-size ring buffer, so recording a span
+    requires no locking; if a thread records more spans than the buffer holds, the oldest
+    are overwritten. Nothing is recorded unless tracing has been started
+*/
+
+#include <chrono>
+#include <string>
+
+/// number of spans retained for each thread
+constexpr size_t TRACE_BUFFER_SIZE { 16'384 };
+
+/*! \brief              Start recording spans
+    \param  filename    name of the file to which the trace is written when the program exits
+*/
+void start_tracing(const std::string& filename);
+
+/// is tracing active?
+bool tracing_enabled(void);
+
+/*! \brief          Record a span on the calling thread
+    \param  name    name of the span
+    \param  start   time at which the span started
+    \param  end     time at which the span ended
+
+    Does nothing if tracing is not active. Names longer than 47 characters are truncated
+*/
+void trace_span(const std::string& name, const std::chrono::steady_clock::time_point start, const std::chrono::steady_clock::time_point end);
+
+/*! \brief              Write all the recorded spans
+    \param  filename    name of the file to which the trace is written
+
+    Should be called only when no other thread is recording spans.
+    Throws exception if the file cannot be written
+*/
+void write_trace(const std::string& filename);
+
+// -----------  trace_scope  ----------------
+
+/*!     \class trace_scope
+        \brief record a span from construction until destruction
+*/
+
+class trace_scope
+{
+protected:
+
+  std::string                           _name;      ///< name of the span
+  std::chrono::steady_clock::time_point _start;     ///< time at which the span started
+  bool                                  _active;    ///< was tracing active when the span started?
+
+public:
+
+/*! \brief          Constructor; starts the span
+    \param  name    name of the span
+*/
+  explicit trace_scope(const std::string& name) :
+    _active(tracing_enabled())
+  { if (_active)
+    { _name = name;
+      _start = std::chrono::steady_clock::now();
+    }
+  }
+
+  trace_scope(const trace_scope&) = delete;
+  trace_scope& operator=(const trace_scope&) = delete;
+
+/// destructor; records the span
+  inline ~trace_scope(void)
+  { if (_active)
+      trace_span(_name, _start, std::chrono::steady_clock::now());
+  }
+};
+
+#endif    // FCC_TRACE_H
@@ -0,0 +1,105 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   command-line.cpp
+
+    Simple parsing of the command line
+*/
+
+#include "command-line.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/// is a string an option?
+static inline bool is_option(const string& str)
+  { return str.starts_with("--"); }
+
+// -----------  command_line  ----------------
+
+/*!     \class command_line
+        \brief access the command line in a more convenient manner
+*/
+
+/*! \brief                      Constructor
+    \param  argc                number of arguments (including the program name)
+    \param  argv                the arguments
+    \param  valued_options      options that take a value
+*/
+command_line::command_line(const int argc, char** argv, const set<string>& valued_options) :
+  _valued_options(valued_options)
+{ for (int n = 1; n < argc; ++n)
+    _args.push_back(argv[n]);
+}
+
+/*! \brief      Is a particular parameter present?
+    \param  p   parameter for which to test
+    \return     whether <i>p</i> is present
+*/
+bool command_line::parameter_present(const string& p) const
+  { return (find(_args.begin(), _args.end(), p) != _args.end()); }
+
+/*! \brief      Is a particular valued option present (with a value)?
+    \param  v   option for which to test
+    \return     whether <i>v</i> is present and is followed by a value
+*/
+bool command_line::value_present(const string& v) const
+{ const auto it { find(_args.begin(), _args.end(), v) };
+
+  return ( (it != _args.end()) and (next(it) != _args.end()) );
+}
+
+/*! \brief      Get the value of a valued option
+    \param  v   option whose value is to be returned
+    \return     the value of option <i>v</i>
+
+    Returns the empty string if <i>v</i> is not present or has no value
+*/
+string command_line::value(const string& v) const
+{ const auto it { find(_args.begin(), _args.end(), v) };
+
+  return ( ( (it == _args.end()) or (next(it) == _args.end()) ) ? string() : *next(it) );
+}
+
+/// all the positional (i.e., non-option) arguments, in order
+vector<string> command_line::positional(void) const
+{ vector<string> rv;
+
+  for (size_t n = 0; n < _args.size(); ++n)
+  { const string& arg { _args[n] };
+
+    if (is_option(arg))
+    { if (_valued_options.contains(arg))
+        ++n;                                // skip the value
+    }
+    else
+      rv.push_back(arg);
+  }
+
+  return rv;
+}
+
+/// all the options that are not known, in order
+vector<string> command_line::unknown_options(const set<string>& known_parameters) const
+{ vector<string> rv;
+
+  for (size_t n = 0; n < _args.size(); ++n)
+  { const string& arg { _args[n] };
+
+    if (is_option(arg))
+    { if (_valued_options.contains(arg))
+        ++n;
+      else
+        if (!known_parameters.contains(arg))
+          rv.push_back(arg);
+    }
+  }
+
+  return rv;
+}
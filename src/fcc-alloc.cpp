@@ -0,0 +1,207 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-alloc.cpp
+
+    Counting the allocations made by each thread, by replacing the global operators new and delete
+*/
+
+#include "fcc-alloc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+using namespace std;
+
+static atomic<bool> tracking_is_enabled { false };
+
+static thread_local alloc_counts counts;        ///< trivial, so that it needs no dynamic initialisation on first use by operator new
+
+/// enable or disable tracking
+void enable_alloc_tracking(const bool b)
+  { tracking_is_enabled = b; }
+
+/// is tracking enabled?
+bool alloc_tracking_enabled(void)
+  { return tracking_is_enabled.load(memory_order_relaxed); }
+
+/// the counts for the calling thread
+alloc_counts thread_alloc_counts(void)
+  { return counts; }
+
+/*! \brief      Set the peak number of live bytes of the calling thread to the current number
+    \return     the previous peak
+*/
+int64_t reset_peak_alloc_bytes(void)
+{ const int64_t rv { counts.peak_bytes };
+
+  counts.peak_bytes = counts.live_bytes;
+
+  return rv;
+}
+
+/*! \brief          Ensure that the peak number of live bytes of the calling thread is at least a particular value
+    \param  peak    the value
+*/
+void restore_peak_alloc_bytes(const int64_t peak)
+{ if (peak > counts.peak_bytes)
+    counts.peak_bytes = peak;
+}
+
+/*! \brief      Count an allocation
+    \param  p   the allocated block; may be nullptr
+    \return     <i>p</i>
+*/
+static inline void* note_alloc(void* p)
+{ if (p and alloc_tracking_enabled())
+  { const int64_t size { static_cast<int64_t>(malloc_usable_size(p)) };
+
+    counts.n_allocs++;
+    counts.bytes += size;
+    counts.live_bytes += size;
+
+    if (counts.live_bytes > counts.peak_bytes)
+      counts.peak_bytes = counts.live_bytes;
+  }
+
+  return p;
+}
+
+/*! \brief      Count and perform a deallocation
+    \param  p   the block to be freed; may be nullptr
+*/
+static inline void note_free(void* p)
+{ if (p and alloc_tracking_enabled())
+    counts.live_bytes -= static_cast<int64_t>(malloc_usable_size(p));
+
+  free(p);
+}
+
+/*! \brief      Allocate memory, as the standard operator new does
+    \param  n   number of bytes
+    \return     the allocated block; nullptr only if new_handler is null
+*/
+static void* allocate(size_t n)
+{ if (n == 0)
+    n = 1;
+
+  void* p;
+
+  while ( (p = malloc(n)) == nullptr )
+  { new_handler handler { get_new_handler() };
+
+    if (!handler)
+      return nullptr;
+
+    handler();
+  }
+
+  return note_alloc(p);
+}
+
+/*! \brief          Allocate aligned memory, as the standard operator new does
+    \param  n       number of bytes
+    \param  align   alignment
+    \return         the allocated block; nullptr only if new_handler is null
+*/
+static void* allocate_aligned(size_t n, const align_val_t align)
+{ const size_t alignment { max(static_cast<size_t>(align), sizeof(void*)) };
+
+  n = max(((n + alignment - 1) / alignment) * alignment, alignment);    // aligned_alloc requires a multiple of the alignment
+
+  void* p;
+
+  while ( (p = aligned_alloc(alignment, n)) == nullptr )
+  { new_handler handler { get_new_handler() };
+
+    if (!handler)
+      return nullptr;
+
+    handler();
+  }
+
+  return note_alloc(p);
+}
+
+// the replacements of the global operators
+
+void* operator new(size_t n)
+{ void* p { allocate(n) };
+
+  if (!p)
+    throw bad_alloc();
+
+  return p;
+}
+
+void* operator new[](size_t n)
+  { return operator new(n); }
+
+void* operator new(size_t n, const nothrow_t&) noexcept
+  { return allocate(n); }
+
+void* operator new[](size_t n, const nothrow_t&) noexcept
+  { return allocate(n); }
+
+void* operator new(size_t n, align_val_t align)
+{ void* p { allocate_aligned(n, align) };
+
+  if (!p)
+    throw bad_alloc();
+
+  return p;
+}
+
+void* operator new[](size_t n, align_val_t align)
+  { return operator new(n, align); }
+
+void* operator new(size_t n, align_val_t align, const nothrow_t&) noexcept
+  { return allocate_aligned(n, align); }
+
+void* operator new[](size_t n, align_val_t align, const nothrow_t&) noexcept
+  { return allocate_aligned(n, align); }
+
+void operator delete(void* p) noexcept
+  { note_free(p); }
+
+void operator delete[](void* p) noexcept
+  { note_free(p); }
+
+void operator delete(void* p, size_t) noexcept
+  { note_free(p); }
+
+void operator delete[](void* p, size_t) noexcept
+  { note_free(p); }
+
+void operator delete(void* p, const nothrow_t&) noexcept
+  { note_free(p); }
+
+void operator delete[](void* p, const nothrow_t&) noexcept
+  { note_free(p); }
+
+void operator delete(void* p, align_val_t) noexcept
+  { note_free(p); }
+
+void operator delete[](void* p, align_val_t) noexcept
+  { note_free(p); }
+
+void operator delete(void* p, size_t, align_val_t) noexcept
+  { note_free(p); }
+
+void operator delete[](void* p, size_t, align_val_t) noexcept
+  { note_free(p); }
+
+void operator delete(void* p, align_val_t, const nothrow_t&) noexcept
+  { note_free(p); }
+
+void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept
+  { note_free(p); }
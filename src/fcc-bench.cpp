@@ -0,0 +1,261 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-bench.cpp
+
+    Microbenchmarks of the string functions, record parsing, merging and output
+*/
+
+// fcc-bench [--json] [--filter substring] [--min-time seconds] [--records n] [--seed n]
+
+#include "command-line.h"
+#include "fcc-alloc.h"
+#include "fcc-db.h"
+#include "fcc-stats.h"
+#include "fcc-synth.h"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+
+using namespace std;
+using namespace std::chrono;
+
+/// the usage message, written if the command line contains an unknown option
+const string USAGE { "Usage: fcc-bench [--json] [--filter substring] [--min-time seconds] [--records n] [--seed n]\n"s };
+
+/// the result of a benchmark
+struct bench_result
+{ string   name;                      ///< name of the benchmark
+  uint64_t iterations       { 0 };    ///< number of operations in the timed run
+  double   ns_per_op        { 0 };    ///< mean time per operation
+  double   bytes_per_second { 0 };    ///< throughput; zero if the operation has no natural size in bytes
+  double   allocs_per_op    { 0 };    ///< mean number of allocations per operation
+};
+
+/// prevent the compiler from discarding a value
+template <typename T>
+inline void do_not_optimize(const T& value)
+  { asm volatile("" : : "r,m"(value) : "memory"); }
+
+/*! \brief              Run a benchmark
+    \param  name        name of the benchmark
+    \param  bytes       number of bytes processed by each operation
+    \param  min_time    minimum duration of the timed run, in seconds
+    \param  op          the operation; called with the index of the iteration
+    \return             the result
+
+    The number of iterations is doubled until a run lasts at least <i>min_time</i>. The allocations
+    are counted in a separate run, so that counting them does not affect the time
+*/
+bench_result run_bench(const string& name, const size_t bytes, const double min_time, const function<void(const size_t)>& op)
+{ bench_result rv { name };
+
+  auto timed_run { [&op] (const uint64_t n)
+                     { const auto start { steady_clock::now() };
+
+                       for (uint64_t i = 0; i < n; ++i)
+                         op(i);
+
+                       return duration<double>(steady_clock::now() - start).count();
+                     } };
+
+  timed_run(1);                 // warm up
+
+  uint64_t n       { 1 };
+  double   elapsed { timed_run(n) };
+
+  while (elapsed < min_time)
+  { const uint64_t previous_n { n };
+
+    n = (elapsed > 0) ? max(n * 2, static_cast<uint64_t>(n * min_time * 1.2 / elapsed)) : (n * 2);
+    n = min(n, previous_n * 64);                            // do not grow too quickly from a very short run
+    elapsed = timed_run(n);
+    clear_stage_results();                                  // the stages of the code under test are of no interest here
+  }
+
+  rv.iterations = n;
+  rv.ns_per_op = elapsed * 1e9 / n;
+  rv.bytes_per_second = bytes * n / elapsed;
+
+// count the allocations
+  const uint64_t n_count { min(n, static_cast<uint64_t>(1'000)) };
+
+  enable_alloc_tracking(true);
+
+  const uint64_t allocs_before { thread_alloc_counts().n_allocs };
+
+  for (uint64_t i = 0; i < n_count; ++i)
+    op(i);
+
+  rv.allocs_per_op = static_cast<double>(thread_alloc_counts().n_allocs - allocs_before) / n_count;
+
+  enable_alloc_tracking(false);
+  clear_stage_results();
+
+  return rv;
+}
+
+/*! \brief          Escape a string for inclusion in JSON
+    \param  str     string to escape
+    \return         <i>str</i> with quotation marks and backslashes escaped
+*/
+string json_escape(const string& str)
+{ string rv;
+
+  for (const char c : str)
+  { if (c == '"' or c == '\\')
+      rv += '\\';
+
+    rv += c;
+  }
+
+  return rv;
+}
+
+/// here we go
+int main(int argc, char** argv)
+{ const command_line cl(argc, argv, { "--filter"s, "--min-time"s, "--records"s, "--seed"s });
+
+  if (const vector<string> unknown { cl.unknown_options({ "--json"s }) }; !unknown.empty())
+  { cerr << "Unknown option: " << unknown.front() << endl << USAGE;
+    exit(-1);
+  }
+
+  const double   min_time  { stod(cl.value("--min-time"s, "0.25"s)) };
+  const size_t   n_records { stoul(cl.value("--records"s, "10000"s)) };
+  const uint64_t seed      { stoull(cl.value("--seed"s, "1"s)) };
+  const string   filter    { cl.value("--filter"s) };
+
+// a dataset with realistic distributions of fields
+  synth_rng rng(seed);
+
+  vector<string> calls;
+  string         am_contents;
+  string         en_contents;
+  string         hd_contents;
+  vector<string> am_lines;
+  vector<string> en_lines;
+  vector<string> hd_lines;
+  vector<string> dates;
+
+  for (size_t n = 0; n < n_records; ++n)
+  { const uint64_t id { 1'000'000 + n };
+
+    calls.push_back(synth_callsign(rng));
+    am_lines.push_back(synth_am_line(rng, id, calls.back()));
+    en_lines.push_back(synth_en_line(rng, id, calls.back()));
+    hd_lines.push_back(synth_hd_line(rng, id, calls.back(), false, false));
+    dates.push_back(synth_date(rng, 2000, 2035));
+
+    am_contents += (am_lines.back() + "\r\n"s);
+    en_contents += (en_lines.back() + "\r\n"s);
+    hd_contents += (hd_lines.back() + "\r\n"s);
+  }
+
+  auto mean_size { [] (const vector<string>& vs) { size_t total { 0 };
+
+                                                   for (const string& s : vs)
+                                                     total += s.size();
+
+                                                   return total / max(vs.size(), static_cast<size_t>(1));
+                                                 } };
+
+  vector<string> padded_fields;           // fields with the spaces that are sometimes found in the files
+
+  for (const string& line : en_lines)
+    padded_fields.push_back("  "s + line.substr(0, 20) + "   "s);
+
+  const AM_FILE am_file("AM.dat"s, am_contents);
+  const EN_FILE en_file("EN.dat"s, en_contents);
+  const HD_FILE hd_file("HD.dat"s, hd_contents);
+
+  fcc_file merged;
+
+  merged += am_file;
+  merged += en_file;
+  merged += hd_file;
+
+  const size_t merged_bytes { merged.to_string().size() };
+
+  clear_stage_results();
+
+// the benchmarks
+  vector<bench_result> results;
+
+  auto bench { [&] (const string& name, const size_t bytes, const function<void(const size_t)>& op)
+                 { if (filter.empty() or name.find(filter) != string::npos)
+                     results.push_back(run_bench(name, bytes, min_time, op));
+                 } };
+
+  const size_t n { n_records };
+
+  array<string_view, static_cast<size_t>(EN::N_FIELDS)> en_fields;
+  array<char, ISO_DATE_LENGTH>                          iso_date;
+  string                                                upper_buffer;
+
+  bench("split_string/EN"s, mean_size(en_lines), [&] (const size_t i) { do_not_optimize(split_string(en_lines[i % n], "|"s)); });
+  bench("split_string (view)/EN"s, mean_size(en_lines), [&] (const size_t i) { do_not_optimize(split_string(en_lines[i % n], '|', en_fields)); });
+  bench("to_upper/EN"s, mean_size(en_lines), [&] (const size_t i) { do_not_optimize(to_upper(en_lines[i % n])); });
+  bench("to_upper_in_place/EN"s, mean_size(en_lines), [&] (const size_t i) { upper_buffer.assign(en_lines[i % n]);
+                                                                               to_upper_in_place(upper_buffer);
+                                                                               do_not_optimize(upper_buffer.size());
+                                                                             } );
+  bench("remove_peripheral_spaces"s, mean_size(padded_fields), [&] (const size_t i) { do_not_optimize(remove_peripheral_spaces(padded_fields[i % n])); });
+  bench("trim_spaces"s, mean_size(padded_fields), [&] (const size_t i) { do_not_optimize(trim_spaces(padded_fields[i % n])); });
+  bench("transform_date"s, 10, [&] (const size_t i) { do_not_optimize(transform_date(dates[i % n])); });
+  bench("transform_date (buffer)"s, 10, [&] (const size_t i) { do_not_optimize(transform_date(dates[i % n], iso_date)); });
+  bench("compare_calls"s, 0, [&] (const size_t i) { do_not_optimize(compare_calls(calls[i % n], calls[(i * 7 + 3) % n])); });
+  bench("dat_record<AM>"s, mean_size(am_lines), [&] (const size_t i) { do_not_optimize(AM_RECORD(am_lines[i % n])); });
+  bench("dat_record<EN>"s, mean_size(en_lines), [&] (const size_t i) { do_not_optimize(EN_RECORD(en_lines[i % n])); });
+  bench("dat_record<HD>"s, mean_size(hd_lines), [&] (const size_t i) { do_not_optimize(HD_RECORD(hd_lines[i % n])); });
+  bench("dat_file<EN>"s, en_contents.size(), [&] (const size_t) { do_not_optimize(EN_FILE("EN.dat"s, en_contents)); });
+
+  bench("fcc_file::operator+="s, am_contents.size() + en_contents.size() + hd_contents.size(), [&] (const size_t)
+          { fcc_file outfile;
+
+            outfile += am_file;
+            outfile += en_file;
+            outfile += hd_file;
+
+            do_not_optimize(outfile.size());
+          } );
+
+  bench("fcc_file::to_string"s, merged_bytes, [&] (const size_t) { do_not_optimize(merged.to_string()); });
+
+// report
+  if (cl.parameter_present("--json"s))
+  { cout << "{\"records\":" << n_records << ",\"seed\":" << seed << ",\"benchmarks\":[";
+
+    for (size_t r = 0; r < results.size(); ++r)
+    { const bench_result& result { results[r] };
+
+      char buf[400];
+
+      snprintf(buf, sizeof(buf), "%s\n{\"name\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.2f,\"bytes_per_second\":%.0f,\"allocs_per_op\":%.2f}",
+               (r ? "," : ""), json_escape(result.name).c_str(), static_cast<unsigned long long>(result.iterations), result.ns_per_op,
+               result.bytes_per_second, result.allocs_per_op);
+      cout << buf;
+    }
+
+    cout << "\n]}" << endl;
+  }
+  else
+  { char buf[200];
+
+    snprintf(buf, sizeof(buf), "%-28s %12s %14s %12s %12s", "benchmark", "iterations", "ns/op", "MB/s", "allocs/op");
+    cout << buf << endl;
+
+    for (const bench_result& result : results)
+    { snprintf(buf, sizeof(buf), "%-28s %12llu %14.1f %12.1f %12.2f", result.name.c_str(), static_cast<unsigned long long>(result.iterations),
+               result.ns_per_op, result.bytes_per_second / 1e6, result.allocs_per_op);
+      cout << buf << endl;
+    }
+  }
+}
@@ -12,25 +12,74 @@
     file that is sent to stdout 
 */
 
-// fcc-db [temporary-directory]
+// fcc-db [--shard-by REGION_CODE|STATE|PREFIX [--output-dir directory]] [--index index-file] [--locality-index index-file] [--callsign-filter filter-file]
+//        [--id-range LO:HI] [--snapshot snapshot-file] [--io auto|uring|pread] [--stats] [--perf] [--allocs] [--trace trace-file]
+//        [--metrics-file metrics-file] [--duplicates newest|all|report] [--fields FIELD,...] [--where FIELD=VALUE,...]
+//        [--order callsign|id|none] [temporary-directory]
+// fcc-db combine [--snapshot snapshot-file] [--order callsign|id|none] [--duplicates newest|all|report] [--fields FIELD,...] [--where FIELD=VALUE,...] snapshot-file...
+// fcc-db profile [--stats] [directory]
+// fcc-db locality [--state state] [--zip zip-prefix | --city city] output-file locality-index-file
+// fcc-db lookup call... output-file index-file
+// fcc-db watch [--output output-file] [--id-range LO:HI] [--duplicates newest|all|report] [--stats] [--trace trace-file] [directory]
 
+#include "command-line.h"
 #include "fcc-db.h"
+#include "fcc-filter.h"
+#include "fcc-io.h"
+#include "fcc-locality.h"
+#include "fcc-metrics.h"
+#include "fcc-plan.h"
+#include "fcc-profile.h"
+#include "fcc-snapshot.h"
+#include "fcc-stats.h"
+#include "fcc-trace.h"
 
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <future>
-#include <map>
-#include <thread>
 #include <ranges>
 #include <unordered_set>
 
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace std;
 
-/*! \brief      Helper function to return an object of specified type from a string
-    \param  fn  filename
-    \return     object of type <i>T</i> constructed from <i>fn</i>
+/// the usage message, written if the command line contains an unknown option
+const string USAGE { "Usage: fcc-db [--shard-by REGION_CODE|STATE|PREFIX [--output-dir directory]] [--index index-file] [--locality-index index-file]\n"
+                     "              [--callsign-filter filter-file] [--id-range LO:HI] [--snapshot snapshot-file] [--io auto|uring|pread]\n"
+                     "              [--stats] [--perf] [--allocs] [--trace trace-file] [--metrics-file metrics-file]\n"
+                     "              [--duplicates newest|all|report] [--fields FIELD,...] [--where FIELD=VALUE,...] [--order callsign|id|none]\n"
+                     "              [temporary-directory]\n"
+                     "       fcc-db combine [--snapshot snapshot-file] [--order callsign|id|none] [--duplicates newest|all|report]\n"
+                     "                      [--fields FIELD,...] [--where FIELD=VALUE,...] snapshot-file...\n"
+                     "       fcc-db profile [--stats] [directory]\n"
+                     "       fcc-db locality [--state state] [--zip zip-prefix | --city city] output-file locality-index-file\n"
+                     "       fcc-db lookup call... output-file index-file\n"
+                     "       fcc-db watch [--output output-file] [--id-range LO:HI] [--duplicates newest|all|report] [--stats] [--trace trace-file]\n"
+                     "                    [directory]\n"s };
+
+/*! \brief                      Helper function to return an object of specified type from a file, once the file has been read
+    \param  fn                  filename
+    \param  contents_future     the contents of <i>fn</i>, when they are available
+    \return                     object of type <i>T</i> constructed from the contents of <i>fn</i>
+*/
+template <typename T>
+inline T get_value(const string& fn, future<string> contents_future)
+  { return T(fn, contents_future.get()); }
+
+/*! \brief                      Helper function to return a .DAT file, keeping only some of the fields, once the file has been read
+    \param  fn                  filename
+    \param  contents_future     the contents of <i>fn</i>, when they are available
+    \param  columns             the fields to keep
+    \return                     .DAT file constructed from the contents of <i>fn</i>
 */
 template <typename T>
-inline T get_value(const string& fn)
-  { return T(fn); }
+inline dat_file<T> get_dat_file(const string& fn, future<string> contents_future, const column_mask<T> columns)
+  { return dat_file<T>(fn, contents_future.get(), columns); }
 
 /*! \brief      Convert a range to a particular container type
     \param  r   range
@@ -45,222 +94,947 @@ auto RANGE_CONTAINER(R&& r) -> RT
   return RT(r_common.begin(), r_common.end());
 }
 
-/// here we go
-int main(int argc, char** argv)
-{ string dir { ( (argc > 1) ? argv[1] : "./"s) };    // is there a directory on the command line?
+/*! \brief          Add a trailing slash to a directory name, if necessary
+    \param  dir     directory name
+    \return         <i>dir</i>, ending in a slash
+*/
+inline string directory_name(const string& dir)
+  { return ( (dir.empty() or dir.ends_with('/')) ? dir : dir + '/' ); }
 
-  if (dir[dir.size() - 1] != '/')                    // add the trailing slash if necessary
-    dir += '/';
-    
-// extract the data from the files; it's barely worth doing it in parallel, but we might as well....
-// don't bother with HS, LA, SC and SF files; they don't seem to contain very interesting data
-  future<AM_FILE> am_file_future { async(std::launch::async, get_value<AM_FILE>, dir + "AM.dat"s) };
-  future<CO_FILE> co_file_future { async(std::launch::async, get_value<CO_FILE>, dir + "CO.dat"s) };
-  future<EN_FILE> en_file_future { async(std::launch::async, get_value<EN_FILE>, dir + "EN.dat"s) };
-  future<HD_FILE> hd_file_future { async(std::launch::async, get_value<HD_FILE>, dir + "HD.dat"s) };
- 
-  fcc_file outfile;     // the place to hold the output
+/*! \brief          Create a sidecar offset index for some records
+    \param  recs    records, in the order in which they appear in the output
+    \return         a sample of the callsign and output offset for every OFFSET_INDEX_STRIDE records of <i>recs</i>
+*/
+vector<offset_index_entry> offset_index(const vector<const FCC_RECORD*>& recs)
+{ vector<offset_index_entry> rv;
+
+  uint64_t offset { 0 };
+
+  for (size_t n = 0; n < recs.size(); ++n)
+  { if ( (n % OFFSET_INDEX_STRIDE) == 0)
+      rv.push_back(make_offset_index_entry((*recs[n])[FCC::CALLSIGN], offset));
+
+    offset += (recs[n]->string_length() + 1);   // include the LF
+  }
+
+  return rv;
+}
+
+constexpr size_t OUTPUT_CHUNK_SIZE { 1 << 20 };     ///< the output to stdout is written in pieces of about this size
+
+/*! \brief          Write records to a stream, one per line
+    \param  ost     stream to which the records are written
+    \param  recs    the records, in the order in which they are to appear
+    \param  plan    the plan that defines the fields to write
+    \param  timer   the timer of the stage, to which the records and bytes are added as they are written
+    \return         the number of bytes written
+
+    The records are formatted into a buffer that is written whenever it is full, so the whole output
+    is never held in memory
+*/
+uint64_t write_records(ostream& ost, const vector<const FCC_RECORD*>& recs, const query_plan& plan, stage_timer& timer)
+{ uint64_t rv        { 0 };
+  uint64_t n_pending { 0 };         // number of records in the buffer
+  string   buffer;
+
+  buffer.reserve(OUTPUT_CHUNK_SIZE + OUTPUT_CHUNK_SIZE / 4);
+
+  auto flush { [&] (void)
+                 { ost << buffer;
+                   rv += buffer.size();
+                   timer.add(buffer.size(), n_pending);
+                   timer.progress();
+                   buffer.clear();
+                   n_pending = 0;
+                 } };
+
+  for (const FCC_RECORD* rec_p : recs)
+  { plan.append_to(*rec_p, buffer);
+    buffer += '\n';
+    n_pending++;
+
+    if (buffer.size() >= OUTPUT_CHUNK_SIZE)
+      flush();
+  }
+
+  flush();
+
+  return rv;
+}
+
+/*! \brief              A filter predicate that counts the records that it rejects
+    \param  pred        the predicate
+    \param  n_rejected  counter of rejected records
+    \return             a predicate that returns the same value as <i>pred</i>
+*/
+template <typename P>
+inline auto counting_filter(P pred, uint64_t& n_rejected)
+  { return [pred, &n_rejected] (const auto& rec) { const bool rv { pred(rec) };
+
+                                                   n_rejected += (rv ? 0 : 1);
+                                                   return rv;
+                                                 }; }
+
+// -----------  record_filter  ----------------
+
+/*!     \class record_filter
+        \brief select the records from .DAT files that are to be merged: those in the range of IDs whose licences have neither expired nor been cancelled
+*/
+
+class record_filter
+{
+protected:
+
+  string                _lo_id;               ///< lowest ID to be merged
+  string                _hi_id;               ///< one more than the highest ID to be merged; empty means no upper limit
+  unordered_set<string> _expired_ids;         ///< IDs of licences that have expired
+  unordered_set<string> _cancelled_ids;       ///< IDs of licences that have been cancelled
+
+public:
+
+  uint64_t n_out_of_range { 0 };              ///< number of records outside the range of IDs
+  uint64_t n_expired      { 0 };              ///< number of records of expired licences
+  uint64_t n_cancelled    { 0 };              ///< number of records of cancelled licences
+
+/*! \brief          Constructor
+    \param  hd_file the HD records, from which the expired and cancelled IDs are determined
+    \param  lo_id   lowest ID to be merged
+    \param  hi_id   one more than the highest ID to be merged; empty means no upper limit
+*/
+  record_filter(const HD_FILE& hd_file, const string& lo_id, const string& hi_id) :
+    _lo_id(lo_id),
+    _hi_id(hi_id)
+  { stage_timer timer("dead IDs"s);
+
+    timer.add(0, hd_file.size());
 
 // 240814: the HD file seems to contain expiration dates that might have already passed, so we need to determine any expired IDs (per FCC, Unique System Identifiers) first
-  const string today   { date_string() };
-  const auto   hd_file { hd_file_future.get() };
+    const string today { date_string() };
 
-  auto expired { [&today] (const auto& rec) { return ( !(rec[HD::EXPIRED_DATE].empty()) and (transform_date(rec[HD::EXPIRED_DATE]) < today) ); } }; // condition for a record to have expired
+    auto expired { [&today] (const auto& rec) { array<char, ISO_DATE_LENGTH> iso_date;
 
-  const unordered_set<string> expired_ids { RANGE_CONTAINER<unordered_set<string>> (hd_file | std::ranges::views::filter(expired)
-                                                                                            | std::views::transform( [] (const auto& rec) { return rec[HD::ID]; })) }; // return the ID of the expired record
+                                                return ( !(rec[HD::EXPIRED_DATE].empty()) and (transform_date(rec[HD::EXPIRED_DATE], iso_date) < today) );
+                                              } }; // condition for a record to have expired
 
-  auto unexpired { [&expired_ids] (const auto& rec) { return !expired_ids.contains(rec[1]); } };    // is a record unexpired? rec[1] is the ID
+    _expired_ids = RANGE_CONTAINER<unordered_set<string>> (hd_file | std::ranges::views::filter(expired)
+                                                                   | std::views::transform( [] (const auto& rec) { return rec[HD::ID]; })); // return the ID of the expired record
 
 // 240817: the HD file also seems to contain cancellation dates (for example, if someone has upgraded)
-  auto cancelled { [&today] (const auto& rec) { return ( !(rec[HD::CANCELLATION_DATE].empty()) and (transform_date(rec[HD::CANCELLATION_DATE]) < today) ); } }; // condition for a record to have been cancelled
- 
-  const unordered_set<string> cancelled_ids { RANGE_CONTAINER<unordered_set<string>> (hd_file | std::ranges::views::filter(cancelled)
-                                                                                              | std::views::transform( [] (const auto& rec) { return rec[HD::ID]; })) }; // return the ID of the cancelled record
-                                                                                              
-  auto uncancelled { [&cancelled_ids] (const auto& rec) { return !cancelled_ids.contains(rec[1]); } };    // is a record uncancelled? rec[1] is the ID
-
-  outfile += ( am_file_future.get() | std::ranges::views::filter(unexpired) | std::ranges::views::filter(uncancelled) );      // add all unexpired and uncancelled records
-  outfile += ( co_file_future.get() | std::ranges::views::filter(unexpired) | std::ranges::views::filter(uncancelled) );
-  outfile += ( en_file_future.get() | std::ranges::views::filter(unexpired) | std::ranges::views::filter(uncancelled) );
-  outfile += ( hd_file              | std::ranges::views::filter(unexpired) | std::ranges::views::filter(uncancelled) );
-    
-  outfile.validate();       // check that it looks OK
-    
-// all done; now output it in callsign order
-  cout << outfile.to_string() << endl;
+    auto cancelled { [&today] (const auto& rec) { array<char, ISO_DATE_LENGTH> iso_date;
+
+                                                  return ( !(rec[HD::CANCELLATION_DATE].empty()) and (transform_date(rec[HD::CANCELLATION_DATE], iso_date) < today) );
+                                                } }; // condition for a record to have been cancelled
+
+    _cancelled_ids = RANGE_CONTAINER<unordered_set<string>> (hd_file | std::ranges::views::filter(cancelled)
+                                                                     | std::views::transform( [] (const auto& rec) { return rec[HD::ID]; })); // return the ID of the cancelled record
+  }
+
+/*! \brief          Merge the selected records of a .DAT file
+    \param  outfile the place to hold the output
+    \param  df      the .DAT file
+    \param  name    name of the type of the file, for the name of the stage
+*/
+  template <typename T>
+  void merge(fcc_file& outfile, const dat_file<T>& df, const string& name)
+  { stage_timer timer("merge "s + name);
+
+    timer.add(0, df.size());
+
+    auto ticked      { [&timer] (const auto&) { timer.tick(); return true; } };                                                                     // report progress
+    auto in_range    { [this] (const auto& rec) { return ( !compare_ids(rec[1], _lo_id) and (_hi_id.empty() or compare_ids(rec[1], _hi_id)) ); } };   // rec[1] is the ID
+    auto unexpired   { [this] (const auto& rec) { return !_expired_ids.contains(rec[1]); } };
+    auto uncancelled { [this] (const auto& rec) { return !_cancelled_ids.contains(rec[1]); } };
+
+    outfile += ( df | std::ranges::views::filter(ticked)
+                    | std::ranges::views::filter(counting_filter(in_range, n_out_of_range))
+                    | std::ranges::views::filter(counting_filter(unexpired, n_expired))
+                    | std::ranges::views::filter(counting_filter(uncancelled, n_cancelled)) );
+  }
+};
+
+/*! \brief              Write metrics about a run, in the Prometheus text format
+    \param  filename    name of the metrics file
+    \param  names       names of the files that were read
+    \param  n_read      number of records read from each of <i>names</i>
+    \param  bytes_read  number of bytes read from each of <i>names</i>
+    \param  n_dropped   number of records dropped, by reason
+    \param  n_output    number of records in the output
+    \param  bytes       number of bytes written, by output
+    \param  start       time at which the run started
+
+    Exits if the file cannot be written
+*/
+void write_metrics(const string& filename, const vector<string>& names, const array<uint64_t, 4>& n_read, const array<uint64_t, 4>& bytes_read,
+                   const map<string, uint64_t>& n_dropped, const uint64_t n_output, const map<string, uint64_t>& bytes, const chrono::steady_clock::time_point start)
+{ metrics_file metrics;
+
+// a stage such as "sort" may occur more than once
+  map<string, pair<double, double>> stage_seconds;
+
+  for (const stage_result& result : stage_results())
+  { stage_seconds[result.name].first += result.wall_seconds;
+    stage_seconds[result.name].second += result.cpu_seconds;
+  }
+
+  for (const auto& [ stage, seconds ] : stage_seconds)
+  { metrics.add("fcc_db_stage_duration_seconds"s, "gauge"s, "Elapsed time of each stage of the last run"s, seconds.first, { { "stage"s, stage } });
+    metrics.add("fcc_db_stage_cpu_seconds"s, "gauge"s, "CPU time of each stage of the last run"s, seconds.second, { { "stage"s, stage } });
+  }
+
+  for (size_t n = 0; n < names.size(); ++n)
+  { metrics.add("fcc_db_records_read"s, "gauge"s, "Records read from each .DAT file"s, n_read[n], { { "file"s, names[n] } });
+    metrics.add("fcc_db_bytes_read"s, "gauge"s, "Bytes read from each .DAT file"s, bytes_read[n], { { "file"s, names[n] } });
+  }
+
+  for (const auto& [ reason, n ] : n_dropped)
+    metrics.add("fcc_db_records_dropped"s, "gauge"s, "Records not merged into the output, by reason"s, n, { { "reason"s, reason } });
+
+  metrics.add("fcc_db_output_records"s, "gauge"s, "Records in the output"s, n_output);
+
+  for (const auto& [ output, n ] : bytes)
+    metrics.add("fcc_db_bytes_written"s, "gauge"s, "Bytes written to each output"s, n, { { "output"s, output } });
+
+  metrics.add("fcc_db_peak_rss_bytes"s, "gauge"s, "Peak resident set size of the last run"s, peak_rss_kib() * 1024.0);
+  metrics.add("fcc_db_run_duration_seconds"s, "gauge"s, "Elapsed time of the last run"s, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+  metrics.add("fcc_db_last_run_timestamp_seconds"s, "gauge"s, "Time at which the last run finished, in seconds since the epoch"s,
+              chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count());
+
+  try
+  { metrics.write(filename);
+  }
+
+  catch (...)
+  { exit(-1);
+  }
 }
 
-/// add an AM_RECORD to the file
-void fcc_file::operator+=(const AM_RECORD& amr)
-{ const string& key { amr[AM::ID] };
+/*! \brief      Get the policy for records that have the same call
+    \param  cl  command line
+    \return     the value of --duplicates; NEWEST if it is absent
 
-  FCC_RECORD& rec = (*this)[key];
-  
-// we have a record which may or may not be empty; give it the ID if necessary
-  if (rec[FCC::ID].empty())
-    rec[FCC::ID] = key;
-    
-  rec[FCC::CALLSIGN]                   = amr[AM::CALLSIGN];
-  rec[FCC::OPERATOR_CLASS]             = amr[AM::OPERATOR_CLASS];
-  rec[FCC::GROUP_CODE]                 = amr[AM::GROUP_CODE];
-  rec[FCC::REGION_CODE]                = amr[AM::REGION_CODE];
-  rec[FCC::TRUSTEE_CALLSIGN]           = amr[AM::TRUSTEE_CALLSIGN];
-  rec[FCC::TRUSTEE_INDICATOR]          = amr[AM::TRUSTEE_INDICATOR];
-  rec[FCC::SYSTEMATIC_CALLSIGN_CHANGE] = amr[AM::SYSTEMATIC_CALLSIGN_CHANGE];
-  rec[FCC::VANITY_CALLSIGN_CHANGE]     = amr[AM::VANITY_CALLSIGN_CHANGE];
-  rec[FCC::VANITY_RELATIONSHIP]        = amr[AM::VANITY_RELATIONSHIP];
-  rec[FCC::PREVIOUS_CALLSIGN]          = amr[AM::PREVIOUS_CALLSIGN];
-  rec[FCC::PREVIOUS_OPERATOR_CLASS]    = amr[AM::PREVIOUS_OPERATOR_CLASS];
-  rec[FCC::TRUSTEE_NAME]               = amr[AM::TRUSTEE_NAME];
+    Exits if the value is invalid
+*/
+DUPLICATES duplicates_policy(const command_line& cl)
+{ if (!cl.value_present("--duplicates"s))
+    return DUPLICATES::NEWEST;
+
+  const string duplicates_str { cl.value("--duplicates"s) };
+
+  if (duplicates_str == "newest"s)
+    return DUPLICATES::NEWEST;
+
+  if (duplicates_str == "all"s)
+    return DUPLICATES::ALL;
+
+  if (duplicates_str == "report"s)
+    return DUPLICATES::REPORT;
+
+  cerr << "Unknown value for --duplicates: " << duplicates_str << "; should be newest, all or report" << endl;
+  exit(-1);
+}
+
+/*! \brief      Get the order of the output from the command line
+    \param  cl  command line
+    \return     the value of --order; callsign order if it is absent
+
+    Exits if the value is invalid
+*/
+ORDER output_order(const command_line& cl)
+{ if (!cl.value_present("--order"s))
+    return ORDER::CALLSIGN;
+
+  const string order_str { cl.value("--order"s) };
+
+  if (order_str == "callsign"s)
+    return ORDER::CALLSIGN;
+
+  if (order_str == "id"s)
+    return ORDER::ID;
+
+  if (order_str == "none"s)
+    return ORDER::NONE;
+
+  cerr << "Unknown value for --order: " << order_str << "; should be callsign, id or none" << endl;
+  exit(-1);
 }
 
-/// add a CO_RECORD to the file
-void fcc_file::operator+=(const CO_RECORD& cor)
-{ const string& key { cor[CO::ID] };
+/*! \brief              Merge snapshots, writing the result to stdout or to a snapshot
+    \param  cl          command line
+    \param  filenames   names of the snapshot files
+    \return             exit status
+*/
+int combine(const command_line& cl, const vector<string>& filenames)
+{ const query_plan plan(cl.value("--fields"s, ""s), cl.value("--where"s, ""s));
+
+  const ORDER order { output_order(cl) };
+
+  if (cl.value_present("--snapshot"s))
+  { if (plan.projected() or plan.filtered())
+    { cerr << "--fields and --where may not be used with --snapshot, which needs every field of every record" << endl;
+      exit(-1);
+    }
 
-// look to see if this key exists
-  if (this->find(key) == end())
-  { cerr << "CO key " << key << " not in FCC file " << endl;
+    if ( (order != ORDER::CALLSIGN) or cl.value_present("--duplicates"s) )
+    { cerr << "--order and --duplicates may not be used with --snapshot, which keeps every record in callsign order" << endl;
+      exit(-1);
+    }
+
+    snapshot_writer writer(cl.value("--snapshot"s));
+
+    combine_snapshots(filenames, [&writer] (const FCC_RECORD& rec) { writer += rec; }, DUPLICATES::ALL);      // keep all the records, in case there are further combinations
+    writer.close();
+  }
+  else if (order == ORDER::ID)                            // the merge is in callsign order, so the selected records are held and sorted
+  { vector<FCC_RECORD> selected;
+
+    combine_snapshots(filenames, [&selected, &plan] (const FCC_RECORD& rec) { if (plan.selects(rec))
+                                                                                selected.push_back(rec);
+                                                                            }, duplicates_policy(cl));
+
+    vector<const FCC_RECORD*> recs;
+
+    recs.reserve(selected.size());
+
+    for (const FCC_RECORD& rec : selected)
+      recs.push_back(&rec);
+
+    ranges::sort(recs, [] (const FCC_RECORD* rec1_p, const FCC_RECORD* rec2_p) { return compare_ids(rec1_p->get<FCC::ID>(), rec2_p->get<FCC::ID>()); });
+
+    stage_timer timer("output"s);
+
+    write_records(cout, recs, plan, timer);
+    cout << endl;
+    timer.add(1);                                         // the final LF
+  }
+  else                                                    // callsign order, or NONE, for which the order of the merge will do
+  { string line;                                          // reused for every record
+
+    combine_snapshots(filenames, [&line, &plan] (const FCC_RECORD& rec) { if (plan.selects(rec))          // duplicates are resolved before the conditions are applied
+                                                                          { line.clear();
+                                                                            plan.append_to(rec, line);
+                                                                            line += '\n';
+                                                                            cout << line;
+                                                                          }
+                                                                        }, duplicates_policy(cl));
+    cout << endl;
+  }
+
+  return 0;
+}
+
+/*! \brief              Write the records in a locality to stdout
+    \param  cl          command line
+    \param  filenames   names of the output file and its locality index
+    \return             exit status
+*/
+int locality(const command_line& cl, const vector<string>& filenames)
+{ if ( (filenames.size() != 2) or (!cl.value_present("--state"s) and !cl.value_present("--zip"s) and !cl.value_present("--city"s)) or
+       (cl.value_present("--zip"s) and cl.value_present("--city"s)) )
+  { cerr << "Usage: fcc-db locality [--state state] [--zip zip-prefix | --city city] output-file locality-index-file" << endl;
     exit(-1);
   }
 
-  FCC_RECORD& rec { (*this)[key] };
-  
-// reformat dates
-  auto insert_date = [&cor, &rec] (const auto dst, const auto src) { if (!(cor[src].empty()))
-                                                                       rec[dst] = transform_date(cor[src]);
-                                                                   };  
-  
-  if (rec[FCC::CALLSIGN] != cor[CO::CALLSIGN])
-  { cerr << "CO callsign " << cor[CO::CALLSIGN] << " does not match callsign in FCC file: " << rec[FCC::CALLSIGN] << endl;
+  try
+  { const locality_index index(filenames[0], filenames[1]);
+
+    const string state { to_upper(cl.value("--state"s, ""s)) };
+
+    for (const string_view line : (cl.value_present("--city"s) ? index.city(state, to_upper(cl.value("--city"s))) : index.zip(state, cl.value("--zip"s, ""s))))
+      cout << line << '\n';
+  }
+
+  catch (...)
+  { exit(-1);
+  }
+
+  return 0;
+}
+
+/*! \brief          Write the records of some calls to stdout
+    \param  args    the calls, followed by the names of the output file and its index
+    \return         exit status; 1 if any call is not present
+
+    The records are written in the same order as the calls
+*/
+int lookup(const vector<string>& args)
+{ if (args.size() < 3)
+  { cerr << "Usage: fcc-db lookup call... output-file index-file" << endl;
     exit(-1);
-  }    
-  
-  insert_date(FCC::COMMENT_DATE, CO::COMMENT_DATE);
-
-  rec[FCC::DESCRIPTION]  = cor[CO::DESCRIPTION];
-  rec[FCC::CO_STATUS_CODE]  = cor[CO::STATUS_CODE];
-  
-  insert_date(FCC::CO_STATUS_DATE, CO::STATUS_DATE);
+  }
+
+  int rv { 0 };
+
+  try
+  { const indexed_file file(args[args.size() - 2], args[args.size() - 1]);
+
+    for (size_t n = 0; n < args.size() - 2; ++n)
+    { const string_view line { file.record(to_upper(args[n])) };
+
+      if (line.empty())
+      { cerr << "Call not found: " << args[n] << endl;
+        rv = 1;
+      }
+      else
+        cout << line << '\n';
+    }
+  }
+
+  catch (...)
+  { exit(-1);
+  }
+
+  return rv;
 }
 
-/// add an EN_RECORD to the file
-void fcc_file::operator+=(const EN_RECORD& enr)
-{ const string& key { enr[EN::ID] };
-
-// look to see if this key exists; for some EN records, there is no extant key;
-// probably best to skip the EN record in that case, because we could end up in a horribly
-// inconsistent state because the FCC doesn't seem to maintain internal consistency
-// amongst the .dat files. With any luck, by the following week this record will be fixed 
-// as the state should have changed.
-  if (this->find(key) == end())
-  { //cout << "EN key " << key << " not in FCC file " << endl;
-    return;
-  }
-
-  FCC_RECORD& rec = (*this)[key];
-
-// reformat dates
-  auto insert_date = [&enr, &rec] (const auto dst, const auto src) { if (!(enr[src].empty()))
-                                                                       rec[dst] = transform_date(enr[src]);
-                                                                   };
-  
-  if (rec[FCC::CALLSIGN] != enr[EN::CALLSIGN])  // treat this as a fatal error
-  { cout << "EN callsign " << enr[EN::CALLSIGN] << " does not match callsign in FCC file: " << rec[FCC::CALLSIGN] << endl;
+/*! \brief          Profile the fields of all the .DAT files in a directory, writing the results to stdout
+    \param  dir     directory containing the .DAT files
+    \return         exit status
+
+    The files are read concurrently, and each is profiled as soon as it has been read
+*/
+int profile(const string& dir)
+{ vector<string> filenames;
+
+  for (const string& type : { "AM"s, "CO"s, "EN"s, "HD"s, "HS"s, "LA"s, "SC"s, "SF"s })
+    if (filesystem::exists(dir + type + ".dat"s))
+      filenames.push_back(dir + type + ".dat"s);
+
+  if (filenames.empty())
+  { cerr << "No .DAT files in directory: " << dir << endl;
     exit(-1);
-  }    
-  
-  rec[FCC::ENTITY_NAME]               = enr[EN::ENTITY_NAME];
-  rec[FCC::FIRST_NAME]                = enr[EN::FIRST_NAME];
-  rec[FCC::MIDDLE_INITIAL]            = enr[EN::MIDDLE_INITIAL];
-  rec[FCC::LAST_NAME]                 = enr[EN::LAST_NAME];
-  rec[FCC::SUFFIX]                    = enr[EN::SUFFIX];
-  rec[FCC::PHONE]                     = enr[EN::PHONE];
-  rec[FCC::FAX]                       = enr[EN::FAX];
-  rec[FCC::EMAIL]                     = enr[EN::EMAIL];
-  rec[FCC::STREET_ADDRESS]            = enr[EN::STREET_ADDRESS];
-  rec[FCC::CITY]                      = enr[EN::CITY];
-  rec[FCC::STATE]                     = enr[EN::STATE];
-  rec[FCC::ZIP_CODE]                  = enr[EN::ZIP_CODE];
-  rec[FCC::PO_BOX]                    = enr[EN::PO_BOX];
-  rec[FCC::ATTENTION_LINE]            = enr[EN::ATTENTION_LINE];
-  rec[FCC::FRN]                       = enr[EN::FRN];
-  rec[FCC::APPLICANT_TYPE_CODE]       = enr[EN::APPLICANT_TYPE_CODE];
-  rec[FCC::APPLICANT_TYPE_CODE_OTHER] = enr[EN::APPLICANT_TYPE_CODE_OTHER];
-  rec[FCC::EN_STATUS_CODE]            = enr[EN::STATUS_CODE];
-  
-  insert_date(FCC::EN_STATUS_DATE, EN::STATUS_DATE);
+  }
+
+  vector<future<file_profile>> profile_futures(filenames.size());
+
+  try
+  { read_files(filenames, [&filenames, &profile_futures] (const size_t n, string&& contents) { profile_futures[n] = async(std::launch::async, profile_file, filenames[n], std::move(contents)); });
+
+    vector<file_profile> profiles;
+
+    for (auto& f : profile_futures)
+      profiles.push_back(f.get());
+
+    print_profiles(cout, profiles);
+  }
+
+  catch (...)
+  { exit(-1);
+  }
+
+  if (stats_enabled())
+    print_stats(cerr);
+
+  return 0;
+}
+
+// -----------  watch  ----------------
+
+constexpr chrono::seconds WATCH_SETTLE_TIME { 2 };      ///< time without further changes after which a new set of files is assumed to be complete
+constexpr chrono::seconds WATCH_DATE_CHECK  { 60 };     ///< interval between checks for a change of date, which can change the licences that have expired
+
+/// the identity of a version of a file
+struct file_signature
+{ dev_t   dev      { 0 };
+  ino_t   ino      { 0 };
+  off_t   size     { 0 };
+  int64_t mtime_ns { 0 };
+
+  bool operator==(const file_signature&) const = default;
+};
+
+/*! \brief          Get the signature of a file
+    \param  fn      name of the file
+    \return         the signature of <i>fn</i>; the default signature if the file does not exist
+*/
+file_signature signature(const string& fn)
+{ struct stat stat_buffer;
+
+  if (stat(fn.c_str(), &stat_buffer))
+    return { };
+
+  return { stat_buffer.st_dev, stat_buffer.st_ino, stat_buffer.st_size, stat_buffer.st_mtim.tv_sec * 1'000'000'000LL + stat_buffer.st_mtim.tv_nsec };
+}
+
+/// a parsed .DAT file, and the version of the file from which it was parsed
+template <typename T>
+struct cached_dat_file
+{ file_signature sig;         ///< signature of the file when it was parsed
+  T              records;     ///< the parsed file
+};
+
+/*! \brief          Parse a .DAT file again if it has changed
+    \param  cache   the cached version of the file
+    \param  fn      name of the file
+    \return         whether the file was parsed
+
+    Throws exception if the file cannot be parsed, in which case <i>cache</i> is unchanged
+*/
+template <typename T>
+bool refresh(cached_dat_file<T>& cache, const string& fn)
+{ const file_signature sig { signature(fn) };
+
+  if (sig == cache.sig)
+    return false;
+
+  cache.records = T(fn);
+  cache.sig = sig;
+
+  return true;
 }
 
-/// add an HD_RECORD to the file
-void fcc_file::operator+=(const HD_RECORD& hdr)
-{ const string& key { hdr[HD::ID] };
-
-// look to see if this key exists; for some HD records, there is no extant key;
-// probably best to skip the HD record in that case, because we could end up in a horribly
-// inconsistent state because the FCC doesn't seem to maintain internal consistency
-// amongst the .dat files. With any luck, by the following week, this record will be fixed 
-// as the state should have changed.
-  if (this->find(key) == end())
-  { //cerr << "HD key " << key << " not in FCC file " << endl;
-    return;
-  }
-  
-  FCC_RECORD& rec { (*this)[key] };
-
-// reformat dates
-  auto insert_date = [&hdr, &rec] (const auto dst, const auto src) { if (!(hdr[src].empty()))
-                                                                 rec[dst] = transform_date(hdr[src]);
-                                                             };
-  
-  if (rec[FCC::CALLSIGN] != hdr[HD::CALLSIGN])
-  { cout << "HD callsign " << hdr[HD::CALLSIGN] << " does not match callsign in FCC file: " << rec[FCC::CALLSIGN] << endl;
+/*! \brief          Watch a directory, writing the output again whenever the .DAT files change
+    \param  cl      command line
+    \param  dir     directory containing the .DAT files
+    \param  lo_id   lowest ID to be merged
+    \param  hi_id   one more than the highest ID to be merged; empty means no upper limit
+    \return         exit status
+
+    Runs until killed. The parsed files are kept in memory, and only the files that have changed are
+    parsed again. Every write to a .DAT file restarts the wait for the files to settle, so that a slowly
+    written set of files is not merged part way through. The output replaces the previous output atomically,
+    so a reader never sees a partial file; if a rebuild fails, including because the files are inconsistent
+    with one another, the previous output remains in place. The output is always the whole of each record, in
+    callsign order; if tracing is active, the trace is written again after each rebuild
+*/
+int watch(const command_line& cl, const string& dir, const string& lo_id, const string& hi_id)
+{ const string     output_fn  { cl.value("--output"s, dir + "fcc-db.txt"s) };
+  const DUPLICATES duplicates { duplicates_policy(cl) };
+
+  const int inotify_fd { inotify_init1(IN_CLOEXEC) };
+
+  if ( (inotify_fd < 0) or (inotify_add_watch(inotify_fd, (dir.empty() ? "."s : dir).c_str(), IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO) < 0) )
+  { cerr << "Cannot watch directory: " << dir << "; " << strerror(errno) << endl;
     exit(-1);
-  }    
-
-  rec[FCC::LICENSE_STATUS]     = hdr[HD::LICENSE_STATUS];
-  rec[FCC::RADIO_SERVICE_CODE] = hdr[HD::RADIO_SERVICE_CODE];
-  
-  insert_date(FCC::GRANT_DATE, HD::GRANT_DATE);
-  insert_date(FCC::EXPIRED_DATE, HD::EXPIRED_DATE);
-  insert_date(FCC::CANCELLATION_DATE, HD::CANCELLATION_DATE);
-  
-  rec[FCC::ELIGIBILITY_RULE_NUM] = hdr[HD::ELIGIBILITY_RULE_NUM];
-  rec[FCC::REVOKED]              = hdr[HD::REVOKED];
-  rec[FCC::CONVICTED]            = hdr[HD::CONVICTED];
-  rec[FCC::ADJUDGED]             = hdr[HD::ADJUDGED];
-  
-  insert_date(FCC::EFFECTIVE_DATE, HD::EFFECTIVE_DATE);
-  insert_date(FCC::LAST_ACTION_DATE, HD::LAST_ACTION_DATE);
-  
-  rec[FCC::LICENSEE_NAME_CHANGE] = hdr[HD::LICENSEE_NAME_CHANGE];
+  }
+
+  cached_dat_file<AM_FILE> am_cache;
+  cached_dat_file<CO_FILE> co_cache;
+  cached_dat_file<EN_FILE> en_cache;
+  cached_dat_file<HD_FILE> hd_cache;
+
+  string built_date;          // the date of the last successful rebuild
+
+// returns whether the output was written
+  auto rebuild { [&] (void)
+                   { clear_stage_results();
+
+                     const auto   start { chrono::steady_clock::now() };
+                     const string today { date_string() };
+
+                     string parsed;                 // the files that were parsed again
+
+                     try
+                     { future<bool> am_future { async(std::launch::async, refresh<AM_FILE>, ref(am_cache), dir + "AM.dat"s) };
+                       future<bool> co_future { async(std::launch::async, refresh<CO_FILE>, ref(co_cache), dir + "CO.dat"s) };
+                       future<bool> en_future { async(std::launch::async, refresh<EN_FILE>, ref(en_cache), dir + "EN.dat"s) };
+                       future<bool> hd_future { async(std::launch::async, refresh<HD_FILE>, ref(hd_cache), dir + "HD.dat"s) };
+
+                       for (auto [ f_p, name ] : { pair { &am_future, "AM.dat"s }, pair { &co_future, "CO.dat"s }, pair { &en_future, "EN.dat"s }, pair { &hd_future, "HD.dat"s } })
+                         if (f_p->get())
+                           parsed += ( (parsed.empty() ? ""s : " "s) + name );
+                     }
+
+                     catch (...)
+                     { cerr << "Unable to parse the files in " << dir << "; keeping the previous output" << endl;
+                       return false;
+                     }
+
+                     if (parsed.empty() and (today == built_date))
+                       return false;
+
+                     fcc_file      outfile;
+                     record_filter filter(hd_cache.records, lo_id, hi_id);
+
+                     outfile.throw_on_error(true);                 // files that are inconsistent must not end the process
+
+                     try
+                     { filter.merge(outfile, am_cache.records, "AM"s);
+                       filter.merge(outfile, co_cache.records, "CO"s);
+                       filter.merge(outfile, en_cache.records, "EN"s);
+                       filter.merge(outfile, hd_cache.records, "HD"s);
+                     }
+
+                     catch (...)
+                     { cerr << "Unable to merge the files in " << dir << "; keeping the previous output" << endl;
+                       return false;
+                     }
+
+                     { stage_timer timer("validate"s);
+
+                       timer.add(0, outfile.size());
+                       outfile.validate();
+                     }
+
+                     const vector<const FCC_RECORD*> recs { outfile.ordered_records(duplicates) };
+
+                     try
+                     { stage_timer timer("output"s);
+
+                       const string output { outfile.to_string(recs) + "\n"s };     // the same as the output to stdout
+
+                       write_file_atomically(output_fn, output);
+                       timer.add(output.size(), recs.size());
+                     }
+
+                     catch (...)
+                     { return false;
+                     }
+
+                     built_date = today;
+
+                     cerr << "Wrote " << output_fn << ": " << recs.size() << " records; parsed: " << (parsed.empty() ? "none"s : parsed)
+                          << "; " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " s" << endl;
+
+                     if (stats_enabled())
+                       print_stats(cerr);
+
+                     if (tracing_enabled())           // the process is normally killed, so the trace is not written at exit
+                     { try
+                       { write_trace(cl.value("--trace"s));
+                       }
+
+                       catch (...)
+                       { cerr << "Unable to write the trace to " << cl.value("--trace"s) << endl;
+                       }
+                     }
+
+                     return true;
+                   } };
+
+  rebuild();
+
+  bool                             pending     { false };     // have the files changed since the last rebuild?
+  chrono::steady_clock::time_point last_change;
+
+  array<char, 64 * 1024> buffer;
+
+  while (true)
+  { const auto timeout { pending ? chrono::duration_cast<chrono::milliseconds>(last_change + WATCH_SETTLE_TIME - chrono::steady_clock::now())
+                                 : chrono::duration_cast<chrono::milliseconds>(WATCH_DATE_CHECK) };
+
+    pollfd pfd { inotify_fd, POLLIN, 0 };
+
+    const int status { poll(&pfd, 1, max(static_cast<int>(timeout.count()), 0)) };
+
+    if ( (status < 0) and (errno != EINTR) )
+    { cerr << "Error waiting for changes to directory: " << dir << "; " << strerror(errno) << endl;
+      exit(-1);
+    }
+
+    if ( (status > 0) and (pfd.revents & POLLIN) )
+    { const ssize_t len { read(inotify_fd, buffer.data(), buffer.size()) };
+
+      for (ssize_t posn = 0; posn < len; )
+      { const inotify_event* event_p { reinterpret_cast<const inotify_event*>(buffer.data() + posn) };
+
+        if (event_p->len)
+        { const string name { event_p->name };
+
+          if ( (name == "AM.dat"s) or (name == "CO.dat"s) or (name == "EN.dat"s) or (name == "HD.dat"s) )
+          { pending = true;
+            last_change = chrono::steady_clock::now();
+          }
+        }
+
+        posn += (sizeof(inotify_event) + event_p->len);
+      }
+    }
+
+    if (pending)
+    { if (chrono::steady_clock::now() - last_change >= WATCH_SETTLE_TIME)     // wait until all the files have been written
+      { pending = false;
+        rebuild();
+      }
+    }
+    else
+      if (date_string() != built_date)
+        rebuild();
+  }
 }
 
-/// convert to a string
-const string fcc_file::to_string(void) const
-{
-// put it all in callsign order; this takes a while, but it's simple and fast enough
-// note that if multiple records have the same call, only the first is used; no attempt
-// is made to merge the records or to decide amongst them
-  map<string, FCC_RECORD, decltype(&compare_calls)> output_map(compare_calls);
+/// here we go
+int main(int argc, char** argv)
+{ const auto start { chrono::steady_clock::now() };
 
-  for (const auto& [ callsign, fcc_rec ] : *this)
-    output_map.insert( { fcc_rec[FCC::CALLSIGN], fcc_rec } );
-    
-// it's now in the right order; build the string and return it
-  string rv;
+  const command_line cl(argc, argv, { "--callsign-filter"s, "--city"s, "--duplicates"s, "--fields"s, "--id-range"s, "--index"s, "--io"s, "--locality-index"s, "--metrics-file"s, "--order"s, "--output"s, "--output-dir"s, "--shard-by"s, "--snapshot"s, "--state"s, "--trace"s, "--where"s, "--zip"s });
+
+  if (const vector<string> unknown { cl.unknown_options({ "--allocs"s, "--perf"s, "--stats"s }) }; !unknown.empty())
+  { cerr << "Unknown option: " << unknown.front() << endl << USAGE;
+    exit(-1);
+  }
+
+  const vector<string> args { cl.positional() };
+
+  if (!args.empty() and (args[0] == "combine"s))
+    return combine(cl, vector<string>(args.begin() + 1, args.end()));
+
+  if (!args.empty() and (args[0] == "locality"s))
+    return locality(cl, vector<string>(args.begin() + 1, args.end()));
+
+  if (!args.empty() and (args[0] == "lookup"s))
+    return lookup(vector<string>(args.begin() + 1, args.end()));
+
+  enable_stats(cl.parameter_present("--stats"s) or cl.parameter_present("--perf"s) or cl.parameter_present("--allocs"s));
+  enable_alloc_tracking(cl.parameter_present("--allocs"s));
+
+  if (cl.parameter_present("--perf"s))
+    enable_perf_counters();               // writes a warning if the counters are not available
+
+  if (cl.value_present("--trace"s))
+    start_tracing(cl.value("--trace"s));
+
+  if (!args.empty() and (args[0] == "profile"s))
+    return profile(directory_name( (args.size() > 1) ? args[1] : "./"s ));
+
+  const string dir { directory_name(args.empty() ? "./"s : args[0]) };    // is there a directory on the command line?
+
+// the range of IDs to process: LO <= ID < HI; an empty HI means no upper limit
+  string lo_id;
+  string hi_id;
+
+  if (cl.value_present("--id-range"s))
+  { const vector<string> limits { split_string(cl.value("--id-range"s), ":"s) };
+
+    auto is_id { [] (const string& str) { return ranges::all_of(str, [] (const char c) { return static_cast<bool>(isdigit(static_cast<unsigned char>(c))); }); } };
+
+    const bool has_hi { (limits.size() == 2) and !limits[1].empty() };
+
+    if (!limits.empty() and (limits.size() <= 2))
+    { lo_id = remove_leading(limits[0], '0');                             // compare_ids() requires IDs without leading zeroes
+      hi_id = ( has_hi ? remove_leading(limits[1], '0') : string() );
+    }
+
+    if ( (limits.empty()) or (limits.size() > 2) or !ranges::all_of(limits, is_id) or (has_hi and !compare_ids(lo_id, hi_id)) )
+    { cerr << "Invalid value for --id-range: " << cl.value("--id-range"s) << "; should be LO:HI, with LO < HI" << endl;
+      exit(-1);
+    }
+  }
+
+  if (!args.empty() and (args[0] == "watch"s))
+  { for (const string& option : { "--callsign-filter"s, "--fields"s, "--index"s, "--io"s, "--locality-index"s, "--metrics-file"s, "--output-dir"s, "--shard-by"s, "--snapshot"s, "--where"s })
+      if (cl.value_present(option))
+      { cerr << option << " may not be used with watch" << endl;
+        exit(-1);
+      }
+
+    if (output_order(cl) != ORDER::CALLSIGN)
+    { cerr << "--order may not be used with watch, which writes in callsign order" << endl;
+      exit(-1);
+    }
+
+    return watch(cl, directory_name( (args.size() > 1) ? args[1] : "./"s ), lo_id, hi_id);
+  }
+
+  SHARD_BY shard_by { SHARD_BY::REGION_CODE };
+
+  if (cl.value_present("--shard-by"s))
+  { const string shard_str { cl.value("--shard-by"s) };
+
+    if (shard_str == "REGION_CODE"s)
+      shard_by = SHARD_BY::REGION_CODE;
+    else if (shard_str == "STATE"s)
+      shard_by = SHARD_BY::STATE;
+    else if (shard_str == "PREFIX"s)
+      shard_by = SHARD_BY::PREFIX;
+    else
+    { cerr << "Unknown value for --shard-by: " << shard_str << "; should be REGION_CODE, STATE or PREFIX" << endl;
+      exit(-1);
+    }
+  }
     
-  for (const auto& [ callsign, output_rec ] : output_map)
-    rv += ( output_rec.to_string() + '\n' );
+  const DUPLICATES duplicates { duplicates_policy(cl) };
+  const ORDER      order      { output_order(cl) };
+
+  if (order != ORDER::CALLSIGN)
+  { if (duplicates == DUPLICATES::REPORT)
+    { cerr << "--duplicates report requires callsign order" << endl;
+      exit(-1);
+    }
+
+    if (cl.value_present("--index"s))
+    { cerr << "--index requires callsign order" << endl;
+      exit(-1);
+    }
+  }
+
+  const query_plan plan(cl.value("--fields"s, ""s), cl.value("--where"s, ""s));
+
+  if ( (plan.projected() or plan.filtered()) and cl.value_present("--shard-by"s) )
+  { cerr << "--fields and --where apply only to the output to stdout, and may not be used with --shard-by" << endl;
+    exit(-1);
+  }
+
+  if ( (cl.value_present("--index"s) or cl.value_present("--locality-index"s)) and cl.value_present("--shard-by"s) )
+  { cerr << "--index and --locality-index apply only to the output to stdout, and may not be used with --shard-by" << endl;
+    exit(-1);
+  }
+
+  if (plan.projected() and (cl.value_present("--index"s) or cl.value_present("--locality-index"s) or cl.value_present("--snapshot"s)))
+  { cerr << "--fields may not be used with --index, --locality-index or --snapshot, which need every field" << endl;
+    exit(-1);
+  }
+
+  if (stats_enabled())
+    cerr << plan.description() << endl;
+
+  READ_METHOD read_method { READ_METHOD::AUTO };
+
+  if (cl.value_present("--io"s))
+  { const string io_str { cl.value("--io"s) };
+
+    if (io_str == "auto"s)
+      read_method = READ_METHOD::AUTO;
+    else if (io_str == "uring"s)
+      read_method = READ_METHOD::URING;
+    else if (io_str == "pread"s)
+      read_method = READ_METHOD::PREAD;
+    else
+    { cerr << "Unknown value for --io: " << io_str << "; should be auto, uring or pread" << endl;
+      exit(-1);
+    }
+  }
+
+// read all the files concurrently; each is parsed as soon as it has been read, so that reading
+// the remaining files overlaps with the parsing
+// don't bother with HS, LA, SC and SF files; they don't seem to contain very interesting data
+// nor with CO and EN files, if the plan does not need them
+  const vector<string> filenames { dir + "AM.dat"s, dir + "CO.dat"s, dir + "EN.dat"s, dir + "HD.dat"s };
+  const array<bool, 4> needed    { plan.needs<AM>(), plan.needs<CO>(), plan.needs<EN>(), plan.needs<HD>() };
+
+  vector<string> filenames_to_read;
+  vector<size_t> file_numbers;                      // the number in filenames of each file in filenames_to_read
+
+  for (size_t n = 0; n < filenames.size(); ++n)
+    if (needed[n])
+    { filenames_to_read.push_back(filenames[n]);
+      file_numbers.push_back(n);
+    }
+
+  array<promise<string>, 4> contents_promises;
+  array<uint64_t, 4>        bytes_read { };        // each element is written before the corresponding promise is satisfied
+
+  future<void> reader_future { async(std::launch::async, [&filenames_to_read, &file_numbers, &contents_promises, &bytes_read, read_method] (void)
+                                                           { try
+                                                             { stage_timer timer("read"s);
+
+                                                               read_files(filenames_to_read, [&file_numbers, &contents_promises, &bytes_read, &timer] (const size_t m, string&& contents)
+                                                                                               { const size_t n { file_numbers[m] };
+
+                                                                                                 timer.add(contents.size(), 1);
+                                                                                                 bytes_read[n] = contents.size();
+                                                                                                 contents_promises[n].set_value(std::move(contents));
+                                                                                               }, read_method);
+                                                             }
+
+                                                             catch (...)                   // pass the problem on to any file still waiting for its contents
+                                                             { for (auto& p : contents_promises)
+                                                               { try
+                                                                 { p.set_exception(current_exception());
+                                                                 }
+
+                                                                 catch (const future_error&)
+                                                                 { }
+                                                               }
+                                                             }
+                                                           } ) };
+
+// a file that is not needed has no future, and is not parsed
+  auto parse { [&] <typename T> (const size_t n) { return ( needed[n] ? async(std::launch::async, get_dat_file<T>, filenames[n], contents_promises[n].get_future(), plan.columns<T>())
+                                                                        : future<dat_file<T>>() );
+                                                 } };
+
+  future<AM_FILE> am_file_future { parse.template operator()<AM>(0) };
+  future<CO_FILE> co_file_future { parse.template operator()<CO>(1) };
+  future<EN_FILE> en_file_future { parse.template operator()<EN>(2) };
+  future<HD_FILE> hd_file_future { parse.template operator()<HD>(3) };
+ 
+  fcc_file outfile;     // the place to hold the output
+
+  const auto hd_file { hd_file_future.get() };
+
+  record_filter filter(hd_file, lo_id, hi_id);
+
+// add all unexpired and uncancelled records
+  array<uint64_t, 4> n_read { };
+
+  auto merge { [&] (const auto& dat_file, const size_t n) { n_read[n] = dat_file.size();
+                                                            filter.merge(outfile, dat_file, filenames[n].substr(dir.size(), 2));
+                                                          } };
+
+  merge(am_file_future.get(), 0);
+
+  if (co_file_future.valid())
+    merge(co_file_future.get(), 1);
+
+  if (en_file_future.valid())
+    merge(en_file_future.get(), 2);
+
+  merge(hd_file, 3);
+
+  { stage_timer timer("validate"s);
+
+    timer.add(0, outfile.size());
+    outfile.validate();       // check that it looks OK
+  }
+
+  map<string, uint64_t> bytes_written;       // bytes written to each output
+
+  if (cl.value_present("--callsign-filter"s))                                                                 // all the live calls
+  { write_callsign_filter(cl.value("--callsign-filter"s), RANGE_CONTAINER<vector<string>>(outfile | std::views::transform( [] (const auto& pr) { return pr.second[FCC::CALLSIGN]; })));
+    bytes_written["callsign-filter"s] = filesystem::file_size(cl.value("--callsign-filter"s));
+  }
     
-  return rv;
-}
+  if (cl.value_present("--snapshot"s))                                        // all the records, including those with duplicate calls
+  { write_snapshot(cl.value("--snapshot"s), outfile.ordered_records(DUPLICATES::ALL));
+    bytes_written["snapshot"s] = filesystem::file_size(cl.value("--snapshot"s));
+  }
+
+// all done; now output it in callsign order
+  output_totals totals;
+
+  if (cl.value_present("--shard-by"s))
+  { totals = outfile.write_shards(shard_by, directory_name(cl.value("--output-dir"s, "./"s)), duplicates, order);
+    bytes_written["shards"s] = totals.bytes;
+  }
+  else
+  { const vector<const FCC_RECORD*> recs { plan.select(outfile.ordered_records(duplicates, order)) };    // duplicates are resolved before the conditions are applied
+
+    stage_timer timer("output"s);
+
+    const uint64_t n_bytes { write_records(cout, recs, plan, timer) };
 
-/// eliminate invalid records
-void fcc_file::validate(void)
-{ erase_if( (*this), [] (const auto& item) { const auto& [key, fcc_record] { item };
+    cout << endl;
 
-                                             return fcc_record[FCC::CALLSIGN].empty();
-                                           } );                                         // remove if no callsign is present
+    totals = { recs.size(), n_bytes + 1 };
+    timer.add(1);                                     // the final LF
+    bytes_written["stdout"s] = totals.bytes;
+
+    if (cl.value_present("--index"s))                 // the offsets in the index refer to the output just written
+    { write_offset_index(cl.value("--index"s), offset_index(recs));
+      bytes_written["index"s] = filesystem::file_size(cl.value("--index"s));
+    }
+
+    if (cl.value_present("--locality-index"s))        // so do the offsets in the locality index
+    { write_locality_index(cl.value("--locality-index"s), recs);
+      bytes_written["locality-index"s] = filesystem::file_size(cl.value("--locality-index"s));
+    }
+  }
+
+  if (stats_enabled())
+    print_stats(cerr);
+
+  if (cl.value_present("--metrics-file"s))
+  { vector<string> names;
+
+    for (const string& fn : filenames)
+      names.push_back(fn.substr(dir.size()));
+
+    const map<string, uint64_t> n_dropped { { "out_of_range"s, filter.n_out_of_range },
+                                            { "expired"s,      filter.n_expired },
+                                            { "cancelled"s,    filter.n_cancelled },
+                                            { "orphan"s,       outfile.n_orphans() }
+                                          };
+
+    write_metrics(cl.value("--metrics-file"s), names, n_read, bytes_read, n_dropped, totals.records, bytes_written, start);
+  }
 }
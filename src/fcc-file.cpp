@@ -0,0 +1,288 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-file.cpp
+
+    The merged FCC records
+*/
+
+#include "fcc-db.h"
+#include "fcc-stats.h"
+#include "fcc-trace.h"
+
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+
+constexpr uint64_t PROGRESS_COMPARISONS { 1 << 20 };    ///< number of comparisons between checks of whether to report the progress of a sort
+
+// -----------  fcc_file  ----------------
+
+/*!     \class fcc_file
+        \brief file created from merging .DAT files
+*/
+
+/*! \brief          Convert some records to a string
+    \param  recs    the records to convert, in the order in which they are to appear
+    \return         <i>recs</i> as a string, one record per line
+*/
+const string fcc_file::to_string(const vector<const FCC_RECORD*>& recs) const
+{ size_t length { 0 };
+
+  for (const FCC_RECORD* output_rec_p : recs)
+    length += (output_rec_p->string_length() + 1);
+
+  string rv;
+
+  rv.reserve(length);                       // the only allocation
+
+  for (const FCC_RECORD* output_rec_p : recs)
+  { output_rec_p->append_to(rv);
+    rv += '\n';
+  }
+    
+  return rv;
+}
+
+/*! \brief              Get the records in output order
+    \param  duplicates  what to do with records that have the same call
+    \param  order       the order of the records
+    \return             pointers to the records, in the order <i>order</i>
+
+    In callsign order, the records are sorted once, after which the records of each call are adjacent, so that
+    duplicates are resolved in a single linear pass; a report is written to cerr if <i>duplicates</i> is REPORT.
+    In the other orders, duplicates are resolved with a table of the newest record of each call, and no
+    report is written; if <i>duplicates</i> is ALL, the records are not keyed, and in NONE order not even sorted
+*/
+vector<const FCC_RECORD*> fcc_file::ordered_records(const DUPLICATES duplicates, const ORDER order) const
+{ stage_timer timer( (order == ORDER::NONE) ? "collect"s : "sort"s );
+
+  timer.add(0, size());
+
+  vector<const FCC_RECORD*> rv;
+
+  rv.reserve(size());
+
+  auto by_id { [] (const FCC_RECORD* rec1_p, const FCC_RECORD* rec2_p) { return compare_ids(rec1_p->get<FCC::ID>(), rec2_p->get<FCC::ID>()); } };
+
+  if ( (order != ORDER::CALLSIGN) and (duplicates == DUPLICATES::ALL) )      // no keys are needed
+  { for (const auto& [ id, fcc_rec ] : *this)
+      rv.push_back(&fcc_rec);
+
+    if (order == ORDER::ID)
+      ranges::sort(rv, by_id);
+
+    return rv;
+  }
+
+  vector<keyed_record> keyed;                       // the key of each call is computed once
+
+  keyed.reserve(size());
+
+  for (const auto& [ id, fcc_rec ] : *this)
+    keyed.emplace_back(fcc_rec);
+
+  if (order != ORDER::CALLSIGN)
+  {
+// keep the record of each call that compare_records() would put first; the tables are freed before the records are sorted
+    { unordered_map<callsign_key, const keyed_record*> newest;          // calls represented exactly by their keys
+      unordered_map<string_view, const keyed_record*>  newest_long;     // calls too long to be represented exactly; normally empty
+
+      newest.reserve(keyed.size());
+
+      auto newest_of_call { [&] (const keyed_record& kr) -> const keyed_record*&
+                              { return ( kr.key.exact() ? newest[kr.key] : newest_long[kr.rec_p->get<FCC::CALLSIGN>()] ); } };
+
+      for (const keyed_record& kr : keyed)
+      { const keyed_record*& newest_p { newest_of_call(kr) };
+
+        if (!newest_p or compare_records(kr, *newest_p))
+          newest_p = &kr;
+      }
+
+      for (const keyed_record& kr : keyed)
+        if (newest_of_call(kr) == &kr)
+          rv.push_back(kr.rec_p);
+    }
+
+    if (order == ORDER::ID)
+      ranges::sort(rv, by_id);
+
+    return rv;
+  }
+
+  uint64_t n_comparisons { 0 };
+
+  ranges::sort(keyed, [&] (const keyed_record& kr1, const keyed_record& kr2) { if ( (++n_comparisons % PROGRESS_COMPARISONS) == 0 )    // a long sort reports progress
+                                                                                 timer.progress();
+
+                                                                               return compare_records(kr1, kr2);
+                                                                             });
+
+  if (duplicates == DUPLICATES::REPORT)
+  { duplicate_reporter reporter(cerr);
+
+    for (const keyed_record& kr : keyed)
+      reporter += kr;
+
+    reporter.close();
+  }
+
+  if (duplicates != DUPLICATES::ALL)        // the first record of each call is the newest
+  { const auto [ first, last ] { ranges::unique(keyed, [] (const keyed_record& kr1, const keyed_record& kr2) { return same_call(kr1, kr2); }) };
+
+    keyed.erase(first, last);
+  }
+
+  ranges::transform(keyed, back_inserter(rv), &keyed_record::rec_p);
+
+  return rv;
+}
+
+/*! \brief              Write the records to one file per shard
+    \param  shard_by    how to divide the records amongst the shards
+    \param  directory   directory in which to write the files
+    \param  duplicates  what to do with records that have the same call
+    \param  order       the order of the records in each file
+    \return             the amount written to all the files
+
+    The files are named <i>shard</i>.txt; they are written in parallel
+*/
+output_totals fcc_file::write_shards(const SHARD_BY shard_by, const string& directory, const DUPLICATES duplicates, const ORDER order) const
+{ auto shard_name { [shard_by] (const FCC_RECORD& rec)
+                      { string rv;
+
+                        switch (shard_by)
+                        { case SHARD_BY::REGION_CODE :
+                            rv = rec[FCC::REGION_CODE];
+                            break;
+
+                          case SHARD_BY::STATE :
+                            rv = rec[FCC::STATE];
+                            break;
+
+                          case SHARD_BY::PREFIX :
+                            rv = callsign_prefix(rec[FCC::CALLSIGN]);
+                            break;
+                        }
+
+                        std::ranges::replace_if(rv, [] (const char c) { return !isalnum(c); }, '_');   // make it safe to use as a filename
+
+                        return (rv.empty() ? "UNKNOWN"s : rv);
+                      } };
+
+// a single pass through the ordered records; each shard receives its records in callsign order
+  const vector<const FCC_RECORD*> recs { ordered_records(duplicates, order) };
+
+  stage_timer timer("output"s);
+
+  map<string, vector<const FCC_RECORD*>> shards;
+
+  for (const FCC_RECORD* rec_p : recs)
+    shards[shard_name(*rec_p)].push_back(rec_p);
+
+  const vector<pair<string, vector<const FCC_RECORD*>>> shard_vec(shards.begin(), shards.end());
+
+  atomic<size_t>   next_shard    { 0 };
+  atomic<uint64_t> bytes_written { 0 };
+
+// each worker takes the next unwritten shard, formats it and writes it
+  auto worker { [&] (void)
+                  { for (size_t n = next_shard++; n < shard_vec.size(); n = next_shard++)
+                    { const auto& [ name, recs ] { shard_vec[n] };
+                      const string  fn           { directory + name + ".txt"s };
+                      trace_scope   span("shard "s + name);
+
+                      string contents;
+
+                      for (const FCC_RECORD* rec_p : recs)
+                      { rec_p->append_to(contents);
+                        contents += '\n';
+                      }
+
+                      ofstream ofs(fn);
+
+                      ofs << contents;
+
+                      if (!ofs)
+                      { cerr << "Error writing shard file: " << fn << endl;
+                        exit(-1);
+                      }
+
+                      bytes_written += contents.size();
+                    }
+                  } };
+
+  const size_t n_threads { min(shard_vec.size(), max(static_cast<size_t>(thread::hardware_concurrency()), static_cast<size_t>(1))) };
+
+  { vector<jthread> workers;
+
+    for (size_t n = 0; n < n_threads; ++n)
+      workers.emplace_back(worker);
+  }
+
+  const output_totals rv { recs.size(), bytes_written };
+
+  timer.add(rv.bytes, rv.records);
+
+  return rv;
+}
+
+/// eliminate invalid records
+void fcc_file::validate(void)
+{ erase_if( (*this), [] (const auto& item) { const auto& [key, fcc_record] { item };
+
+                                             return fcc_record[FCC::CALLSIGN].empty();
+                                           } );                                         // remove if no callsign is present
+}
+
+// -----------  duplicate_reporter  ----------------
+
+/*!     \class duplicate_reporter
+        \brief report the calls that have more than one record
+
+        The records must be presented in the order defined by compare_records()
+*/
+
+/// report the current call, if it has more than one record
+void duplicate_reporter::_flush(void)
+{ if (_group.size() > 1)
+  { _ost << "duplicate " << _call << ":";
+
+    for (size_t n = 0; n < _group.size(); ++n)
+      _ost << (n ? ", "s : " "s) << _group[n].first << " (" << (_group[n].second.empty() ? "no last action date"s : _group[n].second) << (n ? ")"s : "; kept)"s);
+
+    _ost << endl;
+    _n_calls++;
+  }
+
+  _group.clear();
+}
+
+/// add the next record
+void duplicate_reporter::operator+=(const keyed_record& kr)
+{ const FCC_RECORD& rec { *kr.rec_p };
+
+  if ( (kr.key != _key) or (!kr.key.exact() and (rec.get<FCC::CALLSIGN>() != _call)) )
+  { _flush();
+    _key = kr.key;
+    _call = rec.get<FCC::CALLSIGN>();
+  }
+
+  _group.emplace_back(rec.get<FCC::ID>(), rec.get<FCC::LAST_ACTION_DATE>());
+}
+
+/// finish the report
+void duplicate_reporter::close(void)
+{ _flush();
+  _ost << _n_calls << " calls with more than one record" << endl;
+}
@@ -0,0 +1,230 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-filter.cpp
+
+    Construction of a compact membership filter for callsigns
+*/
+
+#include "fcc-filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+/// maximum number of attempts to construct a filter before giving up
+constexpr int MAX_FILTER_ATTEMPTS { 100 };
+
+/// the splitmix64 generator, used to generate seeds
+static uint64_t splitmix64(uint64_t& state)
+{ uint64_t z { (state += 0x9e3779b97f4a7c15) };
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+
+  return z ^ (z >> 31);
+}
+
+/*! \brief          Calculate the parameters of a filter
+    \param  n_keys  number of keys in the filter
+    \return         header containing the parameters (but not the seed) for a filter with <i>n_keys</i> keys
+*/
+static callsign_filter_header filter_parameters(const uint32_t n_keys)
+{ callsign_filter_header rv;
+
+  rv.n_keys              = n_keys;
+  rv.segment_length      = ( (n_keys == 0) ? 4 : min(1U << static_cast<int>(floor(log(n_keys) / log(3.33) + 2.25)), 262'144U) );
+  rv.segment_length_mask = rv.segment_length - 1;
+
+  const double  size_factor        { (n_keys <= 1) ? 0 : max(1.125, 0.875 + 0.25 * log(1'000'000) / log(n_keys)) };
+  const int64_t capacity           { llround(n_keys * size_factor) };
+  const int64_t init_segment_count { (capacity + rv.segment_length - 1) / rv.segment_length - 2 };
+  const int64_t array_length       { (init_segment_count + 2) * rv.segment_length };
+
+  int64_t segment_count { (array_length + rv.segment_length - 1) / rv.segment_length };
+
+  segment_count = ( (segment_count <= 2) ? 1 : segment_count - 2 );
+
+  rv.segment_count        = static_cast<uint32_t>(segment_count);
+  rv.array_length         = static_cast<uint32_t>( (segment_count + 2) * rv.segment_length );
+  rv.segment_count_length = static_cast<uint32_t>(segment_count * rv.segment_length);
+
+  return rv;
+}
+
+/*! \brief          Hash callsigns in parallel
+    \param  calls   callsigns to hash
+    \return         the distinct hashes of <i>calls</i>, in numerical order
+*/
+static vector<uint64_t> distinct_hashes(const vector<string>& calls)
+{ const size_t n_threads  { max(static_cast<size_t>(thread::hardware_concurrency()), static_cast<size_t>(1)) };
+  const size_t chunk_size { (calls.size() + n_threads - 1) / n_threads };
+
+  vector<uint64_t> rv(calls.size());
+
+// each thread hashes and sorts one chunk
+  vector<future<void>> futures;
+
+  for (size_t start = 0; start < calls.size(); start += chunk_size)
+    futures.push_back(async(launch::async, [&rv, &calls, start, chunk_size] (void)
+                              { const size_t end { min(start + chunk_size, calls.size()) };
+
+                                for (size_t n = start; n < end; ++n)
+                                  rv[n] = callsign_hash(calls[n]);
+
+                                sort(rv.begin() + start, rv.begin() + end);
+                              } ));
+
+  for (auto& f : futures)
+    f.get();
+
+// merge the sorted chunks
+  for (size_t width = chunk_size; width < rv.size(); width *= 2)
+    for (size_t start = 0; start + width < rv.size(); start += 2 * width)
+      inplace_merge(rv.begin() + start, rv.begin() + start + width, rv.begin() + min(start + 2 * width, rv.size()));
+
+  rv.erase(unique(rv.begin(), rv.end()), rv.end());
+
+  return rv;
+}
+
+/*! \brief          Build a filter
+    \param  calls   callsigns to be included in the filter (duplicates are permitted)
+    \return         contents of a filter file containing <i>calls</i>
+*/
+vector<uint8_t> build_callsign_filter(const vector<string>& calls)
+{ const vector<uint64_t> keys { distinct_hashes(calls) };
+
+  callsign_filter_header header { filter_parameters(static_cast<uint32_t>(keys.size())) };
+
+  vector<uint8_t>  t2count(header.array_length);     // number of keys at each location (<< 2), XORed with which of the key's locations it is
+  vector<uint64_t> t2hash(header.array_length);      // XOR of the mixed hashes of the keys at each location
+  vector<uint32_t> queue;                            // locations with a single key
+  vector<uint64_t> stack_hash;                       // mixed hashes, in the order in which they were peeled
+  vector<uint8_t>  stack_found;                      // which of its locations each peeled key is to be stored in
+
+  queue.reserve(header.array_length);
+  stack_hash.reserve(keys.size());
+  stack_found.reserve(keys.size());
+
+  uint64_t rng_state { 0x726b2b9d438b9d4d };         // fixed, so that the output is deterministic
+  bool     success   { false };
+
+  for (int attempt = 0; !success and (attempt < MAX_FILTER_ATTEMPTS); ++attempt)
+  { header.seed = splitmix64(rng_state);
+
+    ranges::fill(t2count, 0);
+    ranges::fill(t2hash, 0);
+    stack_hash.clear();
+    stack_found.clear();
+
+    bool overflow { false };
+
+    for (const uint64_t key : keys)
+    { const uint64_t h { murmur64(key + header.seed) };
+
+      for (uint32_t index = 0; index < 3; ++index)
+      { const uint32_t location { filter_location(index, h, header) };
+
+        t2count[location] += 4;
+        t2count[location] ^= index;
+        t2hash[location] ^= h;
+
+        overflow = overflow or (t2count[location] < 4);
+      }
+    }
+
+    if (overflow)                                    // too many keys at one location; try another seed
+      continue;
+
+// peel locations that contain just one key
+    queue.clear();
+
+    for (uint32_t location = 0; location < header.array_length; ++location)
+      if ( (t2count[location] >> 2) == 1 )
+        queue.push_back(location);
+
+    while (!queue.empty())
+    { const uint32_t location { queue.back() };
+
+      queue.pop_back();
+
+      if ( (t2count[location] >> 2) != 1 )           // has been peeled since it was queued
+        continue;
+
+      const uint64_t h     { t2hash[location] };
+      const uint8_t  found { static_cast<uint8_t>(t2count[location] bitand 3) };
+
+      stack_hash.push_back(h);
+      stack_found.push_back(found);
+
+      for (uint32_t index = 0; index < 3; ++index)
+      { const uint32_t other { filter_location(index, h, header) };
+
+        t2count[other] -= 4;
+        t2count[other] ^= index;
+        t2hash[other] ^= h;
+
+        if ( (index != found) and ((t2count[other] >> 2) == 1) )
+          queue.push_back(other);
+      }
+    }
+
+    success = (stack_hash.size() == keys.size());
+  }
+
+  if (!success)
+  { cerr << "Unable to construct callsign filter" << endl;
+    throw exception();
+  }
+
+// assign fingerprints in the reverse of the order in which the keys were peeled
+  vector<uint8_t> rv(sizeof(header) + header.array_length, 0);
+
+  memcpy(rv.data(), &header, sizeof(header));
+
+  uint8_t* fingerprints { rv.data() + sizeof(header) };
+
+  for (size_t n = stack_hash.size(); n-- > 0; )
+  { const uint64_t h { stack_hash[n] };
+
+    array<uint32_t, 3> locations;
+
+    for (uint32_t index = 0; index < 3; ++index)
+      locations[index] = filter_location(index, h, header);
+
+    const uint8_t found { stack_found[n] };
+
+    fingerprints[locations[found]] = filter_fingerprint(h) ^ fingerprints[locations[(found + 1) % 3]] ^ fingerprints[locations[(found + 2) % 3]];
+  }
+
+  return rv;
+}
+
+/*! \brief              Build a filter and write it to a file
+    \param  filename    name of file to write
+    \param  calls       callsigns to be included in the filter (duplicates are permitted)
+
+    Throws exception if the file cannot be written
+*/
+void write_callsign_filter(const string& filename, const vector<string>& calls)
+{ const vector<uint8_t> bytes { build_callsign_filter(calls) };
+
+  ofstream ofs(filename, ios::binary);
+
+  ofs.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+
+  if (!ofs)
+  { cerr << ("Error writing callsign filter: "s + filename) << endl;
+    throw exception();
+  }
+}
@@ -0,0 +1,289 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-gen.cpp
+
+    Program to generate synthetic FCC .DAT files, for testing at scale
+*/
+
+// fcc-gen [--seed n] [--scale x] [--records n] [--co f] [--hs f] [--la f] [--sc f] [--sf f]
+//         [--expired f] [--cancelled f] [--line-feeds f] [--orphans f] [--duplicates f]
+//         [--name-length lo:hi] [--address-length lo:hi] [--comment-length lo:hi] [--lf] [output-directory]
+//
+// --records     number of licences (AM, EN and HD records); default 1,500,000 times --scale
+// --co ... --sf mean number of records of each type per licence
+// --expired     fraction of licences that have expired
+// --cancelled   fraction of licences that have been cancelled
+// --line-feeds  fraction of EN and CO records with a line feed inside a field
+// --orphans     number of EN and HD records without an AM record, as a fraction of the number of licences
+// --duplicates  fraction of licences whose call has been used by an earlier licence
+// --lf          end lines with LF rather than CR LF
+
+#include "command-line.h"
+#include "fcc-db.h"
+#include "fcc-synth.h"
+
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+using namespace std;
+
+/// the usage message, written if the command line contains an unknown option
+const string USAGE { "Usage: fcc-gen [--seed n] [--scale x] [--records n] [--co f] [--hs f] [--la f] [--sc f] [--sf f]\n"
+                     "               [--expired f] [--cancelled f] [--line-feeds f] [--orphans f] [--duplicates f]\n"
+                     "               [--name-length lo:hi] [--address-length lo:hi] [--comment-length lo:hi] [--lf] [output-directory]\n"s };
+
+constexpr size_t REAL_RECORDS     { 1'500'000 };        ///< approximate number of licences in the real dataset
+constexpr size_t RECENT_CALLS     { 4'096 };            ///< number of recent calls from which duplicates are chosen
+constexpr size_t FILE_BUFFER_SIZE { 1 << 20 };          ///< size of the buffer for each output file
+
+/*! \brief              Get a non-negative number from the command line
+    \param  cl          the command line
+    \param  option      the option
+    \param  def         value to return if the option is absent
+    \param  max_value   largest permitted value
+    \return             the value of <i>option</i>
+
+    Exits if the value is not a number between 0 and <i>max_value</i>
+*/
+double non_negative(const command_line& cl, const string& option, const double def, const double max_value = numeric_limits<double>::max())
+{ if (!cl.value_present(option))
+    return def;
+
+  try
+  { const double rv { stod(cl.value(option)) };
+
+    if ( (rv >= 0) and (rv <= max_value) )
+      return rv;
+  }
+
+  catch (...)
+  { }
+
+  cerr << "Invalid value for " << option << ": " << cl.value(option) << endl;
+  exit(-1);
+}
+
+/*! \brief              Get a fraction from the command line
+    \param  cl          the command line
+    \param  option      the option
+    \param  def         value to return if the option is absent
+    \return             the value of <i>option</i>
+
+    Exits if the value is not a number between 0 and 1
+*/
+inline double fraction(const command_line& cl, const string& option, const double def)
+  { return non_negative(cl, option, def, 1.0); }
+
+/*! \brief              Get a range of lengths from the command line
+    \param  cl          the command line
+    \param  option      the option, whose value has the form LO:HI
+    \return             the range; empty if the option is absent
+
+    Exits if the value is not a valid range
+*/
+length_range lengths(const command_line& cl, const string& option)
+{ if (!cl.value_present(option))
+    return { };
+
+  const string         value  { cl.value(option) };
+  const vector<string> bounds { split_string(value, ":"s) };
+
+  try
+  { if (bounds.size() == 2)
+    { const length_range rv { stoul(bounds[0]), stoul(bounds[1]) };
+
+      if (rv.lo <= rv.hi and rv.hi > 0)
+        return rv;
+    }
+  }
+
+  catch (...)
+  { }
+
+  cerr << "Invalid value for " << option << ": " << value << "; should be LO:HI" << endl;
+  exit(-1);
+}
+
+/*! \brief      The number of records to generate for a mean rate
+    \param  rng the generator
+    \param  f   mean number of records
+    \return     the integral part of <i>f</i>, plus one with a probability equal to the fractional part
+*/
+inline size_t n_records(synth_rng& rng, const double f)
+  { return static_cast<size_t>(f) + (rng.chance(f - static_cast<size_t>(f)) ? 1 : 0); }
+
+// -----------  dat_writer  ----------------
+
+/*!     \class dat_writer
+        \brief write the records of a .DAT file, counting them
+*/
+
+class dat_writer
+{
+protected:
+
+  string        _filename;          ///< name of the file
+  vector<char>  _buffer;            ///< buffer for the stream
+  ofstream      _ofs;               ///< the stream
+  const string& _eol;               ///< EOL marker
+  size_t        _n_records { 0 };   ///< number of records written
+
+public:
+
+/*! \brief              Constructor
+    \param  filename    name of the file
+    \param  eol         EOL marker
+*/
+  dat_writer(const string& filename, const string& eol) :
+    _filename(filename),
+    _buffer(FILE_BUFFER_SIZE),
+    _eol(eol)
+  { _ofs.rdbuf()->pubsetbuf(_buffer.data(), _buffer.size());
+    _ofs.open(filename, ios::binary);
+
+    if (!_ofs)
+    { cerr << "Cannot open file: " << filename << endl;
+      exit(-1);
+    }
+  }
+
+/// write a record
+  inline void operator+=(const string& line)
+  { _ofs << line << _eol;
+    _n_records++;
+  }
+
+/// flush and close the file, and report the number of records
+  void close(void)
+  { _ofs.close();
+
+    if (!_ofs)
+    { cerr << "Error writing file: " << _filename << endl;
+      exit(-1);
+    }
+
+    cerr << _filename << ": " << _n_records << " records" << endl;
+  }
+};
+
+/// here we go
+int main(int argc, char** argv)
+{ const command_line cl(argc, argv, { "--address-length"s, "--cancelled"s, "--co"s, "--comment-length"s, "--duplicates"s, "--expired"s, "--hs"s, "--la"s,
+                                      "--line-feeds"s, "--name-length"s, "--orphans"s, "--records"s, "--scale"s, "--sc"s, "--seed"s, "--sf"s });
+
+  if (const vector<string> unknown { cl.unknown_options({ "--lf"s }) }; !unknown.empty())
+  { cerr << "Unknown option: " << unknown.front() << endl << USAGE;
+    exit(-1);
+  }
+
+  const vector<string> args { cl.positional() };
+  const string         dir  { args.empty() ? "./"s : (args[0].ends_with('/') ? args[0] : args[0] + '/') };
+
+  const double   scale      { non_negative(cl, "--scale"s, 1.0) };
+  const size_t   n_licences { cl.value_present("--records"s) ? static_cast<size_t>(non_negative(cl, "--records"s, 0)) : static_cast<size_t>(REAL_RECORDS * scale) };
+  uint64_t seed { 1 };
+
+  if (cl.value_present("--seed"s))
+  { try
+    { seed = stoull(cl.value("--seed"s));
+    }
+
+    catch (...)
+    { cerr << "Invalid value for --seed: " << cl.value("--seed"s) << endl;
+      exit(-1);
+    }
+  }
+
+  const double co_rate    { non_negative(cl, "--co"s, 0.1) };
+  const double hs_rate    { non_negative(cl, "--hs"s, 3.0) };
+  const double la_rate    { non_negative(cl, "--la"s, 0.01) };
+  const double sc_rate    { non_negative(cl, "--sc"s, 0.1) };
+  const double sf_rate    { non_negative(cl, "--sf"s, 0.02) };
+  const double expired    { fraction(cl, "--expired"s, 0.05) };
+  const double cancelled  { fraction(cl, "--cancelled"s, 0.02) };
+  const double line_feeds { fraction(cl, "--line-feeds"s, 0.0005) };
+  const double orphans    { non_negative(cl, "--orphans"s, 0.001) };
+  const double duplicates { fraction(cl, "--duplicates"s, 0.01) };
+
+  const synth_lengths field_lengths { lengths(cl, "--name-length"s), lengths(cl, "--address-length"s), lengths(cl, "--comment-length"s) };
+
+  const string eol { cl.parameter_present("--lf"s) ? "\n"s : "\r\n"s };
+
+  dat_writer am(dir + "AM.dat"s, eol);
+  dat_writer co(dir + "CO.dat"s, eol);
+  dat_writer en(dir + "EN.dat"s, eol);
+  dat_writer hd(dir + "HD.dat"s, eol);
+  dat_writer hs(dir + "HS.dat"s, eol);
+  dat_writer la(dir + "LA.dat"s, eol);
+  dat_writer sc(dir + "SC.dat"s, eol);
+  dat_writer sf(dir + "SF.dat"s, eol);
+
+  synth_rng rng(seed);
+
+  vector<string> recent_calls;              // a ring of recently issued calls, from which duplicates are taken
+  uint64_t       id { 1'000'000 };
+
+  recent_calls.reserve(RECENT_CALLS);
+
+  for (size_t n = 0; n < n_licences; ++n)
+  { id += rng.between(1, 3);                // IDs increase, with gaps
+
+    const bool   duplicate { !recent_calls.empty() and rng.chance(duplicates) };
+    const string cs        { duplicate ? recent_calls[rng.below(recent_calls.size())] : synth_callsign(rng) };
+
+    if (recent_calls.size() < RECENT_CALLS)
+      recent_calls.push_back(cs);
+    else
+      recent_calls[n % RECENT_CALLS] = cs;
+
+    const bool is_cancelled { rng.chance(cancelled) };
+    const bool is_expired   { !is_cancelled and rng.chance(expired) };
+
+    am += synth_am_line(rng, id, cs, field_lengths);
+
+    const string en_line { synth_en_line(rng, id, cs, field_lengths) };
+
+    en += (rng.chance(line_feeds) ? embed_line_feed(rng, en_line, static_cast<size_t>(EN::STREET_ADDRESS)) : en_line);
+    hd += synth_hd_line(rng, id, cs, is_expired, is_cancelled);
+
+    for (size_t r = n_records(rng, co_rate); r; --r)
+    { const string co_line { synth_co_line(rng, id, cs, field_lengths) };
+
+      co += (rng.chance(line_feeds) ? embed_line_feed(rng, co_line, static_cast<size_t>(CO::DESCRIPTION)) : co_line);
+    }
+
+    for (size_t r = n_records(rng, hs_rate); r; --r)
+      hs += synth_hs_line(rng, id, cs);
+
+    for (size_t r = n_records(rng, la_rate); r; --r)
+      la += synth_la_line(rng, id, cs, field_lengths);
+
+    for (size_t r = n_records(rng, sc_rate); r; --r)
+      sc += synth_sc_line(rng, id, cs);
+
+    for (size_t r = n_records(rng, sf_rate); r; --r)
+      sf += synth_sf_line(rng, id, cs, field_lengths);
+
+// an orphan has an ID that is not in AM.dat
+    for (size_t r = n_records(rng, orphans); r; --r)
+    { id += rng.between(1, 3);
+
+      const string orphan_cs { synth_callsign(rng) };
+
+      if (rng.chance(0.5))
+        en += synth_en_line(rng, id, orphan_cs, field_lengths);
+      else
+        hd += synth_hd_line(rng, id, orphan_cs, false, false);
+    }
+  }
+
+  for (dat_writer* writer_p : { &am, &co, &en, &hd, &hs, &la, &sc, &sf })
+    writer_p->close();
+}
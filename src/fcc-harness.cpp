@@ -0,0 +1,498 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-harness.cpp
+
+    Program to run fcc-db in each of its modes over the same dataset, measuring each run
+    and checking that every mode produces exactly the same output as the default mode
+*/
+
+// fcc-harness [--fcc-db program] [--fcc-gen program] [--generate n] [--seed n] [--work-dir directory] [--keep]
+//             [--max-cpus n] [--memory-limit MiB] [--ranges n] [--repeat n] [--json] [dataset-directory]
+//
+// --generate       generate a dataset of n licences with fcc-gen instead of using dataset-directory
+// --max-cpus       largest number of CPUs to which fcc-db is restricted; default all of them
+// --memory-limit   also run the default mode with its address space limited to this size
+// --ranges         number of ID ranges into which the dataset is split for the snapshot and combine mode; default 4
+// --repeat         number of times to run each mode; the fastest run is reported
+//
+// The index-lookup mode builds with --index, then looks up about 1,000 of the calls with fcc-db lookup; its output
+// must be the same as the corresponding lines of the output of the default mode.
+//
+// The exit status is 0 only if every mode succeeded and produced the same output as the default mode
+
+#include "command-line.h"
+#include "fcc-strings.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+/// the usage message, written if the command line contains an unknown option
+const string USAGE { "Usage: fcc-harness [--fcc-db program] [--fcc-gen program] [--generate n] [--seed n] [--work-dir directory] [--keep]\n"
+                     "                   [--max-cpus n] [--memory-limit MiB] [--ranges n] [--repeat n] [--json] [dataset-directory]\n"s };
+
+constexpr size_t COMPARE_BUFFER_SIZE { 1 << 20 };           ///< size of the buffers used to compare outputs
+constexpr size_t LOOKUP_SAMPLES      { 1'000 };             ///< approximate number of calls looked up in the index mode
+
+/// limits on the resources available to a run
+struct run_limits
+{ size_t n_cpus     { 0 };      ///< number of CPUs; 0 for no limit
+  size_t memory_mib { 0 };      ///< size of the address space; 0 for no limit
+};
+
+/// a single execution of a program
+struct step
+{ vector<string> args;            ///< the program and its arguments
+  string         output;          ///< file to which stdout is written; empty to discard it
+};
+
+/// a way of producing the output
+struct mode
+{ string       name;              ///< name of the mode
+  vector<step> steps;             ///< the executions, in order
+  run_limits   limits;            ///< the limits, which apply to every step
+  string       output;            ///< the file containing the output of the final step
+  string       expected;          ///< the file with which the output is compared; empty for the output of the reference mode
+};
+
+/// the measurements of a mode
+struct mode_result
+{ string name;                    ///< name of the mode
+  double wall_seconds { 0 };      ///< elapsed time of all the steps
+  double cpu_seconds  { 0 };      ///< user and system time of all the steps
+  long   maxrss_kib   { 0 };      ///< largest peak resident set size of any step
+  bool   succeeded    { false };  ///< did every step succeed?
+  bool   identical    { false };  ///< is the output identical to that of the reference mode?
+  string message;                 ///< description of any failure
+};
+
+/*! \brief          Run a program and wait for it to finish
+    \param  st      the program, its arguments and the destination of its output
+    \param  limits  limits on the resources available to the program
+    \param  result  the measurements, to which those of this run are added
+    \return         whether the program exited with status 0
+*/
+bool run_step(const step& st, const run_limits& limits, mode_result& result)
+{ const auto start { steady_clock::now() };
+
+  const pid_t pid { fork() };
+
+  if (pid == -1)
+  { result.message = "fork failed"s;
+    return false;
+  }
+
+  if (pid == 0)                                       // child
+  { const int fd { open(st.output.empty() ? "/dev/null" : st.output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644) };
+
+    if (fd == -1)
+      _exit(126);
+
+    dup2(fd, STDOUT_FILENO);
+    ::close(fd);
+
+    const int null_fd { open("/dev/null", O_WRONLY) };
+
+    dup2(null_fd, STDERR_FILENO);
+
+    if (limits.n_cpus)                                // the first n_cpus of the CPUs that are available
+    { cpu_set_t available;
+      cpu_set_t wanted;
+
+      CPU_ZERO(&wanted);
+      sched_getaffinity(0, sizeof(available), &available);
+
+      for (size_t cpu = 0, n = 0; cpu < CPU_SETSIZE and n < limits.n_cpus; ++cpu)
+        if (CPU_ISSET(cpu, &available))
+        { CPU_SET(cpu, &wanted);
+          n++;
+        }
+
+      sched_setaffinity(0, sizeof(wanted), &wanted);
+    }
+
+    if (limits.memory_mib)
+    { const rlimit rl { limits.memory_mib << 20, limits.memory_mib << 20 };
+
+      setrlimit(RLIMIT_AS, &rl);
+    }
+
+    vector<char*> argv;
+
+    for (const string& arg : st.args)
+      argv.push_back(const_cast<char*>(arg.c_str()));
+
+    argv.push_back(nullptr);
+
+    execv(argv[0], argv.data());
+    _exit(127);
+  }
+
+  int    status;
+  rusage usage;
+
+  wait4(pid, &status, 0, &usage);
+
+  result.wall_seconds += duration<double>(steady_clock::now() - start).count();
+  result.cpu_seconds += usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+  result.maxrss_kib = max(result.maxrss_kib, usage.ru_maxrss);
+
+  if (WIFEXITED(status) and WEXITSTATUS(status) == 0)
+    return true;
+
+  string command;
+
+  for (const string& arg : st.args)
+    command += ( (command.empty() ? ""s : " "s) + arg );
+
+  result.message = (WIFSIGNALED(status) ? "killed by signal "s + to_string(WTERMSIG(status)) : "exit status "s + to_string(WEXITSTATUS(status))) + ": "s + command;
+
+  return false;
+}
+
+/*! \brief          Find the first difference between two files
+    \param  fn1     name of the first file
+    \param  fn2     name of the second file
+    \return         the offset of the first byte that differs, or the length of the shorter file if one is a prefix of the other; nothing if the files are identical
+*/
+optional<size_t> first_difference(const string& fn1, const string& fn2)
+{ ifstream ifs1(fn1, ios::binary);
+  ifstream ifs2(fn2, ios::binary);
+
+  vector<char> buf1(COMPARE_BUFFER_SIZE);
+  vector<char> buf2(COMPARE_BUFFER_SIZE);
+
+  size_t offset { 0 };
+
+  while (true)
+  { ifs1.read(buf1.data(), buf1.size());
+    ifs2.read(buf2.data(), buf2.size());
+
+    const size_t n1 { static_cast<size_t>(ifs1.gcount()) };
+    const size_t n2 { static_cast<size_t>(ifs2.gcount()) };
+    const auto   mm { mismatch(buf1.begin(), buf1.begin() + min(n1, n2), buf2.begin()) };
+
+    if (mm.first != buf1.begin() + min(n1, n2))
+      return offset + (mm.first - buf1.begin());
+
+    if (n1 != n2)
+      return offset + min(n1, n2);
+
+    if (n1 == 0)
+      return nullopt;
+
+    offset += n1;
+  }
+}
+
+/*! \brief          Describe a position in a file
+    \param  fn      name of the file
+    \param  offset  offset in the file
+    \return         the line number and the contents of the line
+*/
+string describe_position(const string& fn, const size_t offset)
+{ ifstream ifs(fn, ios::binary);
+
+  string line;
+  size_t line_start { 0 };
+  size_t line_nr    { 0 };
+
+  while (getline(ifs, line))
+  { line_nr++;
+
+    if (offset < line_start + line.size() + 1)
+      return "line "s + to_string(line_nr) + ": "s + line;
+
+    line_start += line.size() + 1;
+  }
+
+  return "end of file"s;
+}
+
+/*! \brief          The range of IDs in a dataset
+    \param  dir     directory containing AM.dat
+    \return         the smallest and largest IDs
+*/
+pair<uint64_t, uint64_t> id_limits(const string& dir)
+{ const memory_mapped_file am(dir + "AM.dat"s);
+  const string_view        contents { am.contents() };
+
+  uint64_t lo { numeric_limits<uint64_t>::max() };
+  uint64_t hi { 0 };
+
+  for (size_t posn = 0; posn < contents.size(); )
+  { const size_t eol { min(contents.find('\n', posn), contents.size()) };
+    const size_t sep { contents.find('|', posn) };
+
+    if (sep < eol)
+    { const uint64_t id { strtoull(string(contents.substr(sep + 1, 20)).c_str(), nullptr, 10) };
+
+      if (id)
+      { lo = min(lo, id);
+        hi = max(hi, id);
+      }
+    }
+
+    posn = eol + 1;
+  }
+
+  return { lo, hi };
+}
+
+/// here we go
+int main(int argc, char** argv)
+{ const command_line cl(argc, argv, { "--fcc-db"s, "--fcc-gen"s, "--generate"s, "--max-cpus"s, "--memory-limit"s, "--ranges"s, "--repeat"s, "--seed"s, "--work-dir"s });
+
+  if (const vector<string> unknown { cl.unknown_options({ "--json"s, "--keep"s }) }; !unknown.empty())
+  { cerr << "Unknown option: " << unknown.front() << endl << USAGE;
+    exit(-1);
+  }
+
+  const string program_dir { filesystem::path(argv[0]).parent_path().string() };
+  const string fcc_db      { cl.value("--fcc-db"s, (program_dir.empty() ? "."s : program_dir) + "/fcc-db"s) };
+  const string fcc_gen     { cl.value("--fcc-gen"s, (program_dir.empty() ? "."s : program_dir) + "/fcc-gen"s) };
+
+  size_t max_cpus     { static_cast<size_t>(sysconf(_SC_NPROCESSORS_ONLN)) };
+  size_t memory_limit { 0 };
+  size_t n_ranges     { 4 };
+  size_t n_repeats    { 1 };
+
+  try
+  { max_cpus = stoul(cl.value("--max-cpus"s, to_string(max_cpus)));
+    memory_limit = stoul(cl.value("--memory-limit"s, "0"s));
+    n_ranges = max(stoul(cl.value("--ranges"s, "4"s)), 1ul);
+    n_repeats = max(stoul(cl.value("--repeat"s, "1"s)), 1ul);
+  }
+
+  catch (...)
+  { cerr << "Invalid numerical option" << endl;
+    exit(-1);
+  }
+
+// the work directory holds the outputs of all the modes
+  string work_dir { cl.value("--work-dir"s) };
+
+  if (work_dir.empty())
+  { char tmpl[] { "/tmp/fcc-harness-XXXXXX" };
+
+    if (!mkdtemp(tmpl))
+    { cerr << "Cannot create work directory" << endl;
+      exit(-1);
+    }
+
+    work_dir = tmpl;
+  }
+
+  work_dir += '/';
+  filesystem::create_directories(work_dir);
+
+  string dataset_dir;
+
+  if (cl.value_present("--generate"s))
+  { dataset_dir = work_dir + "data/"s;
+    filesystem::create_directories(dataset_dir);
+
+    mode_result gen_result;
+
+    cerr << "Generating dataset in " << dataset_dir << endl;
+
+    if (!run_step( { { fcc_gen, "--records"s, cl.value("--generate"s), "--seed"s, cl.value("--seed"s, "1"s), dataset_dir }, ""s }, { }, gen_result))
+    { cerr << "Cannot generate dataset: " << gen_result.message << endl;
+      exit(-1);
+    }
+  }
+  else
+  { const vector<string> args { cl.positional() };
+
+    dataset_dir = args.empty() ? "./"s : (args[0].ends_with('/') ? args[0] : args[0] + '/');
+  }
+
+// the modes; the first is the reference
+  vector<mode> modes;
+
+  auto simple_mode { [&] (const string& name, const vector<string>& options, const run_limits limits = { })
+                       { const string output { work_dir + name + ".out"s };
+
+                         vector<string> args { fcc_db };
+
+                         args.insert(args.end(), options.begin(), options.end());
+                         args.push_back(dataset_dir);
+
+                         modes.push_back( { name, { { args, output } }, limits, output } );
+                       } };
+
+  simple_mode("reference"s, { });
+  simple_mode("io-uring"s, { "--io"s, "uring"s });
+  simple_mode("io-pread"s, { "--io"s, "pread"s });
+
+  for (size_t n_cpus = 1; n_cpus < max_cpus; n_cpus *= 2)
+    simple_mode("cpus-"s + to_string(n_cpus), { }, { n_cpus, 0 });
+
+  simple_mode("cpus-"s + to_string(max_cpus), { }, { max_cpus, 0 });
+
+  if (memory_limit)
+    simple_mode("memory-"s + to_string(memory_limit) + "MiB"s, { }, { 0, memory_limit });
+
+// build each range of IDs separately, then combine the snapshots
+  { pair<uint64_t, uint64_t> limits;
+
+    try
+    { limits = id_limits(dataset_dir);
+    }
+
+    catch (...)
+    { cerr << "Cannot read IDs from dataset in " << dataset_dir << endl;
+      exit(-1);
+    }
+
+    const auto [ lo, hi ] { limits };
+
+    mode           split { "ranges-"s + to_string(n_ranges), { }, { }, work_dir + "ranges.out"s };
+    vector<string> combine_args { fcc_db, "combine"s };
+
+    for (size_t r = 0; r < n_ranges; ++r)
+    { const string range_lo { (r == 0) ? "0"s : to_string(lo + (hi - lo + 1) * r / n_ranges) };
+      const string range_hi { (r == n_ranges - 1) ? ""s : to_string(lo + (hi - lo + 1) * (r + 1) / n_ranges) };
+      const string snapshot { work_dir + "range-"s + to_string(r) + ".snap"s };
+
+      split.steps.push_back( { { fcc_db, "--id-range"s, range_lo + ":"s + range_hi, "--snapshot"s, snapshot, dataset_dir }, ""s } );
+      combine_args.push_back(snapshot);
+    }
+
+    split.steps.push_back( { combine_args, split.output } );
+    modes.push_back(split);
+  }
+
+// run them all
+  vector<mode_result> results;
+  bool                all_ok { true };
+
+  auto run_mode { [&] (const mode& m)
+                       { mode_result best;
+
+                         for (size_t n = 0; n < n_repeats; ++n)
+                         { mode_result result { m.name };
+
+                           result.succeeded = all_of(m.steps.begin(), m.steps.end(), [&] (const step& st) { return run_step(st, m.limits, result); });
+
+                           if (n == 0 or !result.succeeded or (best.succeeded and result.wall_seconds < best.wall_seconds))
+                             best = result;
+
+                           if (!result.succeeded)
+                             break;
+                         }
+
+                         if (best.succeeded)
+                         { const string             expected { m.expected.empty() ? modes[0].output : m.expected };
+                           const optional<size_t> diff     { first_difference(expected, m.output) };
+
+                           best.identical = !diff;
+
+                           if (diff)
+                             best.message = "output differs from reference at byte "s + to_string(*diff) + "; reference "s + describe_position(expected, *diff) +
+                                            "; this mode "s + describe_position(m.output, *diff);
+                         }
+
+                         if (!best.succeeded or !best.identical)
+                         { all_ok = false;
+                           cerr << "*** MODE " << m.name << " FAILED: " << best.message << endl;
+                         }
+
+                         results.push_back(best);
+                       } };
+
+  for (const mode& m : modes)
+    run_mode(m);
+
+// build with an offset index, then look up a sample of the calls in the reference output; the records found must be those of the reference
+  if (results[0].succeeded)
+  { vector<string> lines;
+
+    { ifstream ifs(modes[0].output);
+      string   line;
+
+      while (getline(ifs, line))
+        if (!line.empty())
+          lines.push_back(line);
+    }
+
+    const size_t interval { max(lines.size() / LOOKUP_SAMPLES, static_cast<size_t>(1)) };
+
+    mode           index_mode { "index-lookup"s, { }, { }, work_dir + "lookup.out"s, work_dir + "lookup.expected"s };
+    vector<string> lookup_args { fcc_db, "lookup"s };
+    ofstream       expected(index_mode.expected);
+
+    for (size_t n = 0; n < lines.size(); n += interval)
+    { const vector<string> fields { split_string(lines[n], "|"s) };
+
+      if (fields.size() > 1)
+      { lookup_args.push_back(fields[1]);               // the callsign
+        expected << lines[n] << '\n';
+      }
+    }
+
+    expected.close();
+
+    lookup_args.push_back(work_dir + "index.out"s);
+    lookup_args.push_back(work_dir + "index.idx"s);
+
+    index_mode.steps.push_back( { { fcc_db, "--index"s, work_dir + "index.idx"s, dataset_dir }, work_dir + "index.out"s } );
+    index_mode.steps.push_back( { lookup_args, index_mode.output } );
+
+    run_mode(index_mode);
+  }
+
+// report
+  if (cl.parameter_present("--json"s))
+  { cout << "{\"dataset\":\"" << dataset_dir << "\",\"modes\":[";
+
+    for (size_t n = 0; n < results.size(); ++n)
+    { const mode_result& r { results[n] };
+
+      char buf[300];
+
+      snprintf(buf, sizeof(buf), "%s\n{\"name\":\"%s\",\"wall_seconds\":%.3f,\"cpu_seconds\":%.3f,\"maxrss_kib\":%ld,\"succeeded\":%s,\"identical\":%s}",
+               (n ? "," : ""), r.name.c_str(), r.wall_seconds, r.cpu_seconds, r.maxrss_kib, (r.succeeded ? "true" : "false"), (r.identical ? "true" : "false"));
+      cout << buf;
+    }
+
+    cout << "\n]}" << endl;
+  }
+  else
+  { char buf[200];
+
+    snprintf(buf, sizeof(buf), "%-20s %9s %9s %12s  %s", "mode", "wall(s)", "cpu(s)", "maxrss(MiB)", "output");
+    cout << buf << endl;
+
+    for (const mode_result& r : results)
+    { snprintf(buf, sizeof(buf), "%-20s %9.3f %9.3f %12.1f  %s", r.name.c_str(), r.wall_seconds, r.cpu_seconds, r.maxrss_kib / 1024.0,
+               (!r.succeeded ? "FAILED" : (r.identical ? "identical" : "DIFFERENT")));
+      cout << buf << endl;
+    }
+  }
+
+  if (!cl.parameter_present("--keep"s) and !cl.value_present("--work-dir"s))
+    filesystem::remove_all(work_dir);
+
+  return (all_ok ? 0 : 1);
+}
@@ -0,0 +1,492 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-io.cpp
+
+    Reading several input files concurrently
+*/
+
+#include "fcc-io.h"
+#include "fcc-trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+  #include <linux/io_uring.h>
+  #define FCC_HAVE_IO_URING 1
+#endif
+
+using namespace std;
+
+constexpr size_t   READ_CHUNK_SIZE   { 1 << 20 };     ///< size of each read
+constexpr unsigned URING_QUEUE_DEPTH { 64 };          ///< maximum number of reads in flight
+
+/// an open input file; the file is closed when the object is destroyed
+struct input_file
+{ int    fd        { -1 };
+  string contents  { };
+  size_t remaining { 0 };         ///< number of bytes not yet read
+
+  input_file(void) = default;
+
+  input_file(const input_file&) = delete;
+  input_file& operator=(const input_file&) = delete;
+
+/// move constructor; <i>other</i> no longer owns the file
+  input_file(input_file&& other) :
+    fd(exchange(other.fd, -1)),
+    contents(std::move(other.contents)),
+    remaining(other.remaining)
+  { }
+
+/// destructor; close the file if it is still open
+  ~input_file(void)
+  { if (fd >= 0)
+      ::close(fd);
+  }
+};
+
+/*! \brief              Open a file for reading and size a buffer for its contents
+    \param  filename    name of file
+    \return             the open file
+
+    Throws exception if the file does not exist or is a directory
+*/
+static input_file open_input_file(const string& filename)
+{ input_file rv;
+
+  rv.fd = ::open(filename.c_str(), O_RDONLY);
+
+  if (rv.fd < 0)
+  { cerr << ("Cannot open file: "s + filename) << endl;
+    throw exception();
+  }
+
+  struct stat stat_buffer;
+
+  if (fstat(rv.fd, &stat_buffer))
+  { cerr << ("Unable to stat file: "s + filename) << endl;
+    throw exception();
+  }
+
+  if (S_ISDIR(stat_buffer.st_mode))
+  { cerr << (filename + " is a directory"s) << endl;
+    throw exception();
+  }
+
+  rv.contents.resize(static_cast<size_t>(stat_buffer.st_size));
+  rv.remaining = rv.contents.size();
+
+  return rv;
+}
+
+/*! \brief              Read part of a file with pread, retrying short reads
+    \param  file        the file
+    \param  filename    name of the file
+    \param  offset      offset of the first byte to read
+    \param  len         number of bytes to read
+    \return             number of bytes read; less than <i>len</i> only if the end of the file was reached
+
+    Throws exception if the read fails
+*/
+static size_t pread_range(input_file& file, const string& filename, const size_t offset, const size_t len)
+{ size_t done { 0 };
+
+  while (done < len)
+  { const ssize_t status { ::pread(file.fd, file.contents.data() + offset + done, len - done, static_cast<off_t>(offset + done)) };
+
+    if (status < 0)
+    { if (errno == EINTR)
+        continue;
+
+      cerr << ("Error reading file: "s + filename) << endl;
+      throw exception();
+    }
+
+    if (status == 0)                                  // the file has become shorter
+      break;
+
+    done += static_cast<size_t>(status);
+  }
+
+  return done;
+}
+
+/*! \brief              Read the remainder of a file with pread, close it, and pass its contents on
+    \param  file        the file
+    \param  filename    name of the file
+    \param  n           index of the file
+    \param  fn          function to be called with <i>n</i> and the contents of the file
+*/
+static void finish_with_pread(input_file& file, const string& filename, const size_t n, const function<void(const size_t, string&&)>& fn)
+{ const size_t offset { file.contents.size() - file.remaining };
+
+  size_t done;
+
+  { trace_scope span("pread "s + filename.substr(filename.find_last_of('/') + 1));
+
+    done = pread_range(file, filename, offset, file.remaining);
+  }
+
+  if (done < file.remaining)
+    file.contents.resize(offset + done);
+
+  file.remaining = 0;
+  ::close(file.fd);
+  file.fd = -1;
+
+  fn(n, std::move(file.contents));
+}
+
+#if defined(FCC_HAVE_IO_URING)
+
+// -----------  uring  ----------------
+
+/*!     \class uring
+        \brief a minimal io_uring, driven directly through the system calls
+*/
+
+class uring
+{
+protected:
+
+  int           _fd      { -1 };
+  void*         _sq_ptr  { MAP_FAILED };
+  size_t        _sq_size { 0 };
+  void*         _cq_ptr  { MAP_FAILED };
+  size_t        _cq_size { 0 };
+  io_uring_sqe* _sqes    { static_cast<io_uring_sqe*>(MAP_FAILED) };
+  size_t        _sqes_size { 0 };
+
+  unsigned* _sq_head  { nullptr };
+  unsigned* _sq_tail  { nullptr };
+  unsigned* _sq_mask  { nullptr };
+  unsigned* _sq_array { nullptr };
+  unsigned* _cq_head  { nullptr };
+  unsigned* _cq_tail  { nullptr };
+  unsigned* _cq_mask  { nullptr };
+
+  io_uring_cqe* _cqes { nullptr };
+
+  unsigned _to_submit { 0 };          ///< number of SQEs queued but not yet submitted
+
+public:
+
+/// constructor; valid() is false if the kernel does not provide io_uring
+  explicit uring(const unsigned entries)
+  { io_uring_params params { };
+
+    _fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+
+    if (_fd < 0)
+      return;
+
+    _sq_size   = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cq_size   = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+    const bool single_mmap { (params.features bitand IORING_FEAT_SINGLE_MMAP) != 0 };
+
+    if (single_mmap)
+      _sq_size = _cq_size = max(_sq_size, _cq_size);
+
+    _sq_ptr = mmap(nullptr, _sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+
+    if (_sq_ptr == MAP_FAILED)
+      return;
+
+    _cq_ptr = (single_mmap ? _sq_ptr : mmap(nullptr, _cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING));
+
+    if (_cq_ptr == MAP_FAILED)
+      return;
+
+    _sqes = static_cast<io_uring_sqe*>(mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES));
+
+    if (_sqes == MAP_FAILED)
+      return;
+
+    char* sq { static_cast<char*>(_sq_ptr) };
+    char* cq { static_cast<char*>(_cq_ptr) };
+
+    _sq_head  = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    _sq_tail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    _sq_mask  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    _sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    _cq_head  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    _cq_tail  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    _cq_mask  = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    _cqes     = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  }
+
+  uring(const uring&) = delete;
+  uring& operator=(const uring&) = delete;
+
+/// destructor
+  ~uring(void)
+  { if (_sqes != MAP_FAILED)
+      munmap(_sqes, _sqes_size);
+
+    if ( (_cq_ptr != MAP_FAILED) and (_cq_ptr != _sq_ptr) )
+      munmap(_cq_ptr, _cq_size);
+
+    if (_sq_ptr != MAP_FAILED)
+      munmap(_sq_ptr, _sq_size);
+
+    if (_fd >= 0)
+      ::close(_fd);
+  }
+
+/// is the ring usable?
+  inline bool valid(void) const
+    { return (_cqes != nullptr) and (_sqes != MAP_FAILED); }
+
+/// queue a read; returns false if the submission queue is full
+  bool queue_read(const int fd, char* buf, const unsigned len, const uint64_t offset, const uint64_t user_data)
+  { const unsigned tail { *_sq_tail };
+    const unsigned head { __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) };
+
+    if (tail - head > *_sq_mask)
+      return false;
+
+    const unsigned index { tail bitand *_sq_mask };
+
+    io_uring_sqe& sqe { _sqes[index] };
+
+    sqe = io_uring_sqe { };
+    sqe.opcode    = IORING_OP_READ;
+    sqe.fd        = fd;
+    sqe.addr      = reinterpret_cast<uint64_t>(buf);
+    sqe.len       = len;
+    sqe.off       = offset;
+    sqe.user_data = user_data;
+
+    _sq_array[index] = index;
+    __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+    _to_submit++;
+
+    return true;
+  }
+
+/// submit any queued reads and wait until at least one has completed; returns false on error
+  bool submit_and_wait(void)
+  { while (true)
+    { const long status { syscall(__NR_io_uring_enter, _fd, _to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0) };
+
+      if (status >= 0)
+      { _to_submit -= min(_to_submit, static_cast<unsigned>(status));
+        return true;
+      }
+
+      if (errno != EINTR)
+        return false;
+    }
+  }
+
+/// wait until at least one read has completed, without submitting any more; returns false on error
+  bool wait(void)
+  { while (true)
+    { if (syscall(__NR_io_uring_enter, _fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) >= 0)
+        return true;
+
+      if (errno != EINTR)
+        return false;
+    }
+  }
+
+/// number of reads queued but not yet submitted to the kernel
+  inline unsigned unsubmitted(void) const
+    { return _to_submit; }
+
+/// process all available completions; each is consumed before <i>fn</i> is called, so that none is seen twice if <i>fn</i> throws
+  template <typename F>
+  void for_each_completion(F fn)
+  { const unsigned tail { __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE) };
+
+    for (unsigned head = *_cq_head; head != tail; )
+    { const io_uring_cqe cqe { _cqes[head bitand *_cq_mask] };
+
+      __atomic_store_n(_cq_head, ++head, __ATOMIC_RELEASE);
+      fn(cqe.user_data, cqe.res);
+    }
+  }
+};
+
+/*! \brief              Read several files with io_uring
+    \param  filenames   names of the files to read
+    \param  files       the open files
+    \param  fn          function to be called with the index into <i>filenames</i> and the contents of each file
+    \return             false if io_uring is not available, in which case nothing has been read
+*/
+static bool read_with_uring(const vector<string>& filenames, vector<input_file>& files, const function<void(const size_t, string&&)>& fn)
+{ uring ring(URING_QUEUE_DEPTH);
+
+  if (!ring.valid())
+    return false;
+
+  struct chunk
+  { size_t file;
+    size_t offset;
+    size_t len;
+  };
+
+// divide all the files into chunks, taking one from each file in turn so that all the files are read concurrently
+  vector<chunk> chunks;
+
+  for (size_t offset = 0; any_of(files.begin(), files.end(), [offset] (const input_file& f) { return offset < f.contents.size(); }); offset += READ_CHUNK_SIZE)
+    for (size_t n = 0; n < files.size(); ++n)
+      if (offset < files[n].contents.size())
+        chunks.push_back( { n, offset, min(READ_CHUNK_SIZE, files[n].contents.size() - offset) } );
+
+// empty files are already complete
+  for (size_t n = 0; n < files.size(); ++n)
+    if (files[n].contents.empty())
+      finish_with_pread(files[n], filenames[n], n, fn);
+
+  size_t next_chunk { 0 };
+  size_t in_flight  { 0 };
+
+// on an error, wait for the reads that the kernel has accepted before the buffers into which they are writing are freed
+  try
+  { while ( (next_chunk < chunks.size()) or (in_flight != 0) )
+    { while ( (next_chunk < chunks.size()) and (in_flight < URING_QUEUE_DEPTH) )
+      { const chunk& c { chunks[next_chunk] };
+
+        if (!ring.queue_read(files[c.file].fd, files[c.file].contents.data() + c.offset, static_cast<unsigned>(c.len), c.offset, next_chunk))
+          break;
+
+        next_chunk++;
+        in_flight++;
+      }
+
+      bool submitted;
+
+      { trace_scope span("io_uring wait"s);
+
+        submitted = ring.submit_and_wait();
+      }
+
+      if (!submitted)
+      { cerr << "Error submitting reads to io_uring" << endl;
+        throw exception();
+      }
+
+      ring.for_each_completion( [&] (const uint64_t user_data, const int res)
+                                  { in_flight--;
+
+                                    chunk& c    { chunks[user_data] };
+                                    input_file& f { files[c.file] };
+
+                                    if (res > 0)                        // all or part of the chunk was read
+                                    { f.remaining -= static_cast<size_t>(res);
+                                      c.offset += static_cast<size_t>(res);
+                                      c.len -= static_cast<size_t>(res);
+                                    }
+
+                                    if (c.len and (res != 0))           // short read or error (e.g., old kernel without IORING_OP_READ); finish the chunk synchronously
+                                    { const size_t done { pread_range(f, filenames[c.file], c.offset, c.len) };
+
+                                      f.remaining -= done;
+                                      c.len = 0;
+                                    }
+
+                                    if (f.remaining == 0 and f.fd >= 0)
+                                      finish_with_pread(f, filenames[c.file], c.file, fn);
+                                  } );
+    }
+  }
+
+  catch (...)
+  { size_t outstanding { in_flight - ring.unsubmitted() };
+
+    while (outstanding)
+    { if (!ring.wait())
+      { cerr << "Error waiting for io_uring reads to complete" << endl;
+        abort();                                                    // the buffers cannot safely be freed
+      }
+
+      ring.for_each_completion( [&outstanding] (const uint64_t, const int) { outstanding--; } );
+    }
+
+    throw;
+  }
+
+// any file that is still incomplete has become shorter while it was being read; read it again from the start
+  for (size_t n = 0; n < files.size(); ++n)
+    if (files[n].fd >= 0)
+    { files[n].remaining = files[n].contents.size();
+      finish_with_pread(files[n], filenames[n], n, fn);
+    }
+
+  return true;
+}
+
+#endif    // FCC_HAVE_IO_URING
+
+/*! \brief              Read several files concurrently
+    \param  filenames   names of the files to read
+    \param  fn          function to be called with the index into <i>filenames</i> and the contents of each file
+    \param  method      how to read the files
+
+    <i>fn</i> is called for each file as soon as that file has been read completely, so the
+    files are not necessarily processed in the order in which they appear in <i>filenames</i>;
+    <i>fn</i> might be called from more than one thread.
+
+    With io_uring, large reads of all the files are in flight at the same time, so that the
+    I/O is overlapped with whatever <i>fn</i> does with the files that have already been read.
+
+    Throws exception if a file does not exist, is a directory, or cannot be read, or if <i>method</i>
+    is URING and io_uring is not available
+*/
+void read_files(const vector<string>& filenames, const function<void(const size_t, string&&)>& fn, const READ_METHOD method)
+{ vector<input_file> files;
+
+  for (const string& filename : filenames)
+    files.push_back(open_input_file(filename));
+
+#if defined(FCC_HAVE_IO_URING)
+  if (method != READ_METHOD::PREAD)
+    if (read_with_uring(filenames, files, fn))
+      return;
+#endif
+
+  if (method == READ_METHOD::URING)
+  { cerr << "io_uring is not available" << endl;
+    throw exception();
+  }
+
+// pread fallback: one thread per file
+  vector<exception_ptr> errors(files.size());
+
+  { vector<jthread> readers;
+
+    for (size_t n = 0; n < files.size(); ++n)
+      readers.emplace_back( [&, n] (void)
+                              { try
+                                { finish_with_pread(files[n], filenames[n], n, fn);
+                                }
+
+                                catch (...)
+                                { errors[n] = current_exception();
+                                }
+                              } );
+  }
+
+  for (const exception_ptr& e : errors)
+    if (e)
+      rethrow_exception(e);
+}
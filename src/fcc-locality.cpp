@@ -0,0 +1,254 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-locality.cpp
+
+    An index of the output by locality: state, ZIP code and city
+*/
+
+#include "fcc-locality.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+/// a key and a record, before the keys are grouped
+struct locality_item
+{ string   key;           ///< the key
+  uint64_t id;            ///< ID of the record
+  uint64_t offset;        ///< byte offset of the record in the output
+};
+
+/*! \brief              Convert items to a table of keys and postings
+    \param  items       the items; sorted by this function
+    \param  keys        the table, to which the keys are appended
+    \param  postings    the postings, to which the postings are appended
+*/
+static void add_table(vector<locality_item>& items, vector<locality_key_entry>& keys, vector<locality_posting>& postings)
+{ ranges::sort(items, [] (const locality_item& item1, const locality_item& item2) { return (item1.key != item2.key) ? (item1.key < item2.key) : (item1.id < item2.id); });
+
+  for (const locality_item& item : items)
+  { if (keys.empty() or (string_view(keys.back().key.data(), strnlen(keys.back().key.data(), keys.back().key.size())) != item.key))
+    { locality_key_entry entry;
+
+      memcpy(entry.key.data(), item.key.data(), item.key.size());     // the key has already been truncated
+      entry.first = postings.size();
+      keys.push_back(entry);
+    }
+
+    keys.back().count++;
+    postings.push_back( { item.id, item.offset } );
+  }
+}
+
+/*! \brief              Write a locality index
+    \param  filename    name of file to write
+    \param  recs        records, in the order in which they appear in the output
+
+    Throws exception if the file cannot be written
+*/
+void write_locality_index(const string& filename, const vector<const FCC_RECORD*>& recs)
+{ vector<locality_item> zip_items;
+  vector<locality_item> city_items;
+
+  zip_items.reserve(recs.size());
+  city_items.reserve(recs.size());
+
+  uint64_t offset { 0 };
+
+  for (const FCC_RECORD* rec_p : recs)
+  { const string& id_str { rec_p->get<FCC::ID>() };
+    const string& zip    { rec_p->get<FCC::ZIP_CODE>() };
+    const string& city   { rec_p->get<FCC::CITY>() };
+    const string  state  { rec_p->get<FCC::STATE>().empty() ? string(UNKNOWN_STATE) : rec_p->get<FCC::STATE>() };
+
+    uint64_t id { 0 };
+
+    from_chars(id_str.data(), id_str.data() + id_str.size(), id);
+
+    if (!zip.empty())
+      zip_items.push_back( { (state + zip.substr(0, LOCALITY_ZIP_LENGTH)).substr(0, LOCALITY_KEY_LENGTH), id, offset } );
+
+    if (!city.empty())
+      city_items.push_back( { (state + '|' + city).substr(0, LOCALITY_KEY_LENGTH), id, offset } );
+
+    offset += (rec_p->string_length() + 1);   // include the LF
+  }
+
+  vector<locality_key_entry> zip_keys;
+  vector<locality_key_entry> city_keys;
+  vector<locality_posting>   postings;
+
+  postings.reserve(zip_items.size() + city_items.size());
+
+  add_table(zip_items, zip_keys, postings);
+  add_table(city_items, city_keys, postings);
+
+  locality_index_header header;
+
+  header.n_zip_keys = zip_keys.size();
+  header.n_city_keys = city_keys.size();
+  header.n_postings = postings.size();
+
+  ofstream ofs(filename, ios::binary);
+
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  ofs.write(reinterpret_cast<const char*>(zip_keys.data()), zip_keys.size() * sizeof(locality_key_entry));
+  ofs.write(reinterpret_cast<const char*>(city_keys.data()), city_keys.size() * sizeof(locality_key_entry));
+  ofs.write(reinterpret_cast<const char*>(postings.data()), postings.size() * sizeof(locality_posting));
+
+  if (!ofs)
+  { cerr << ("Error writing locality index: "s + filename) << endl;
+    throw exception();
+  }
+}
+
+// -----------  locality_index  ----------------
+
+/*!     \class locality_index
+        \brief an output file and its locality index, both mapped into memory
+
+        The time taken by a query is proportional to the number of records found, plus a term
+        logarithmic in the size of the index for each state
+*/
+
+/*! \brief                  Constructor
+    \param  text_filename   name of the output file
+    \param  index_filename  name of the locality index
+
+    Throws exception if either file cannot be mapped, or if the index is invalid
+*/
+locality_index::locality_index(const string& text_filename, const string& index_filename) :
+  _text(text_filename),
+  _index(index_filename)
+{ const string_view index_contents { _index.contents() };
+
+  locality_index_header header;
+
+  if (index_contents.size() >= sizeof(header))
+    memcpy(&header, index_contents.data(), sizeof(header));
+
+  if ( (index_contents.size() < sizeof(header)) or (header.magic != LOCALITY_INDEX_MAGIC) or
+       (index_contents.size() != sizeof(header) + (header.n_zip_keys + header.n_city_keys) * sizeof(locality_key_entry) + header.n_postings * sizeof(locality_posting)) )
+  { cerr << ("Invalid locality index: "s + index_filename) << endl;
+    throw exception();
+  }
+
+  const char* posn { index_contents.data() + sizeof(header) };
+
+  _zip_keys = span<const locality_key_entry>(reinterpret_cast<const locality_key_entry*>(posn), header.n_zip_keys);
+  posn += (header.n_zip_keys * sizeof(locality_key_entry));
+
+  _city_keys = span<const locality_key_entry>(reinterpret_cast<const locality_key_entry*>(posn), header.n_city_keys);
+  posn += (header.n_city_keys * sizeof(locality_key_entry));
+
+  _postings = span<const locality_posting>(reinterpret_cast<const locality_posting*>(posn), header.n_postings);
+
+  for (const auto& keys : { _zip_keys, _city_keys })
+    for (const locality_key_entry& entry : keys)
+      if (entry.first + entry.count > header.n_postings)
+      { cerr << ("Invalid locality index: "s + index_filename) << endl;
+        throw exception();
+      }
+}
+
+/*! \brief          The postings of the keys that start with a prefix
+    \param  keys    the table
+    \param  state   the state; empty means every state
+    \param  rest    the remainder of the prefix, after the state
+    \param  exact   whether the key must be the same as the prefix, rather than merely start with it
+    \return         the postings of the matching keys, in the order of the table
+
+    The prefix is truncated in the same way as the keys, so an exact match of a long prefix might be a
+    match of only its first LOCALITY_KEY_LENGTH characters
+*/
+vector<locality_posting> locality_index::_find(const span<const locality_key_entry> keys, const string& state, const string& rest, const bool exact) const
+{ auto key_view { [] (const locality_key_entry& entry) { return string_view(entry.key.data(), strnlen(entry.key.data(), entry.key.size())); } };
+  auto before   { [&key_view] (const locality_key_entry& entry, const string& target) { return (key_view(entry) < target); } };
+
+  vector<locality_posting> rv;
+
+// add the postings of the keys that match a particular prefix
+  auto add_matches { [&] (const string& full_prefix)
+                       { const string prefix { full_prefix.substr(0, LOCALITY_KEY_LENGTH) };
+
+                         for (auto it { lower_bound(keys.begin(), keys.end(), prefix, before) }; (it != keys.end()) and key_view(*it).starts_with(prefix); ++it)
+                           if (!exact or (key_view(*it) == prefix))
+                             rv.insert(rv.end(), _postings.begin() + it->first, _postings.begin() + it->first + it->count);
+                       } };
+
+  if (!state.empty())
+    add_matches(state + rest);
+  else                                                    // jump from state to state; each state is a contiguous range of the table
+  { auto it { keys.begin() };
+
+    while (it != keys.end())
+    { const string this_state { key_view(*it).substr(0, UNKNOWN_STATE.size()) };
+
+      add_matches(this_state + rest);
+
+      string next_state { this_state };
+
+      next_state.back()++;                                // the first possible key after this state
+      it = lower_bound(it, keys.end(), next_state, before);
+    }
+  }
+
+  return rv;
+}
+
+/*! \brief          Find the records in a city
+    \param  state   the state; empty means every state
+    \param  city    the city
+    \return         the matching lines of the output, without the trailing LF
+*/
+vector<string_view> locality_index::city(const string& state, const string& city) const
+{ vector<string_view> rv { _lines(_find(_city_keys, state, "|"s + city, true)) };
+
+// a key that has been truncated also refers to the other cities in the state whose names start in the same way
+  if ( (state.empty() ? UNKNOWN_STATE.size() : state.size()) + 1 + city.size() >= LOCALITY_KEY_LENGTH )
+  { auto other_city { [&city] (const string_view line)
+                        { array<string_view, static_cast<size_t>(FCC::N_FIELDS)> fields;
+
+                          split_string(line, '|', fields);
+
+                          return (fields[static_cast<size_t>(FCC::CITY)] != city);
+                        } };
+
+    erase_if(rv, other_city);
+  }
+
+  return rv;
+}
+
+/*! \brief              The lines of the output that are referred to by some postings
+    \param  postings    the postings
+    \return             the lines, without the trailing LF
+*/
+vector<string_view> locality_index::_lines(const vector<locality_posting>& postings) const
+{ const string_view text { _text.contents() };
+
+  vector<string_view> rv;
+
+  rv.reserve(postings.size());
+
+  for (const locality_posting& posting : postings)
+  { if (posting.offset >= text.size())
+      continue;
+
+    const size_t eol { text.find('\n', posting.offset) };
+
+    rv.push_back(text.substr(posting.offset, (eol == string_view::npos) ? string_view::npos : eol - posting.offset));
+  }
+
+  return rv;
+}
@@ -0,0 +1,108 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-metrics.cpp
+
+    Metrics in the Prometheus text format, for the textfile collector of node_exporter
+*/
+
+#include "fcc-metrics.h"
+#include "fcc-strings.h"
+
+#include <cstdio>
+
+using namespace std;
+
+/*! \brief          Escape a label value
+    \param  str     the value
+    \return         <i>str</i> with backslashes, quotation marks and line feeds escaped
+*/
+static string escape_label_value(const string& str)
+{ string rv;
+
+  for (const char c : str)
+  { switch (c)
+    { case '\\' :
+        rv += "\\\\"s;
+        break;
+
+      case '"' :
+        rv += "\\\""s;
+        break;
+
+      case '\n' :
+        rv += "\\n"s;
+        break;
+
+      default :
+        rv += c;
+    }
+  }
+
+  return rv;
+}
+
+// -----------  metrics_file  ----------------
+
+/*!     \class metrics_file
+        \brief a set of metrics, each of which may have several samples with different labels
+*/
+
+/*! \brief          Add a sample
+    \param  name    name of the metric
+    \param  type    type of the metric: "gauge" or "counter"
+    \param  help    description of the metric
+    \param  value   value of the sample
+    \param  labels  labels of the sample
+*/
+void metrics_file::add(const string& name, const string& type, const string& help, const double value, const metric_labels& labels)
+{ family& fam { _families[name] };
+
+  fam.help = help;
+  fam.type = type;
+  fam.samples.push_back( { labels, value } );
+}
+
+/// the metrics in the text format
+string metrics_file::to_string(void) const
+{ string rv;
+
+  for (const auto& [ name, fam ] : _families)
+  { rv += "# HELP "s + name + " "s + fam.help + "\n"s;
+    rv += "# TYPE "s + name + " "s + fam.type + "\n"s;
+
+    for (const auto& [ labels, value ] : fam.samples)
+    { rv += name;
+
+      if (!labels.empty())
+      { rv += '{';
+
+        for (size_t n = 0; n < labels.size(); ++n)
+          rv += ( (n ? ","s : ""s) + labels[n].first + "=\""s + escape_label_value(labels[n].second) + "\""s );
+
+        rv += '}';
+      }
+
+      char buf[32];
+
+      snprintf(buf, sizeof(buf), " %.17g\n", value);
+      rv += buf;
+    }
+  }
+
+  return rv;
+}
+
+/*! \brief              Write the metrics to a file, atomically
+    \param  filename    name of the file
+
+    The metrics are written to a temporary file in the same directory, which is then renamed,
+    so that a reader never sees a partial file. Throws exception on error
+*/
+void metrics_file::write(const string& filename) const
+  { write_file_atomically(filename, to_string()); }     // the textfile collector ignores the temporary file, whose name does not end in .prom
@@ -0,0 +1,167 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-perf.cpp
+
+    Hardware performance counters for the calling thread, using perf_event_open
+*/
+
+#include "fcc-perf.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+/// the events for each counter, in the order of PERF_COUNTER
+constexpr array<uint64_t, N_PERF_COUNTERS> PERF_EVENTS { PERF_COUNT_HW_CPU_CYCLES,
+                                                         PERF_COUNT_HW_INSTRUCTIONS,
+                                                         PERF_COUNT_HW_CACHE_MISSES,
+                                                         PERF_COUNT_HW_BRANCH_MISSES
+                                                       };
+
+static atomic<bool> perf_is_enabled { false };
+
+/*! \brief              Open a counter for the calling thread
+    \param  n           index of the counter
+    \param  group_fd    group leader, or -1 to create a new group
+    \return             file descriptor for the counter; -1 on error
+*/
+static int open_counter(const size_t n, const int group_fd)
+{ perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_EVENTS[n];
+  attr.disabled = (group_fd == -1);                     // the leader starts the whole group
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0 /* this thread */, -1 /* any CPU */, group_fd, 0));
+}
+
+/// accumulate another sample
+perf_sample& perf_sample::operator+=(const perf_sample& ps)
+{ if (ps.valid)
+  { for (size_t n = 0; n < values.size(); ++n)
+      values[n] += ps.values[n];
+
+    valid = true;
+  }
+
+  return *this;
+}
+
+/*! \brief      Enable or disable the counters
+    \param  b   whether to enable the counters
+    \return     whether the counters are available
+
+    If the kernel does not permit access to the counters, a warning is written to stderr
+    and the counters remain disabled
+*/
+bool enable_perf_counters(const bool b)
+{ if (!b)
+  { perf_is_enabled = false;
+    return true;
+  }
+
+  const int fd { open_counter(0, -1) };                 // try to open a counter
+
+  if (fd == -1)
+  { cerr << "Warning: hardware performance counters are not available (" << strerror(errno) << ")" << endl;
+    return false;
+  }
+
+  ::close(fd);
+  perf_is_enabled = true;
+
+  return true;
+}
+
+/// are the counters enabled?
+bool perf_counters_enabled(void)
+  { return perf_is_enabled; }
+
+// -----------  perf_counters  ----------------
+
+/*!     \class perf_counters
+        \brief count events on the calling thread, from construction until read()
+
+        Does nothing unless the counters have been enabled
+*/
+
+/// constructor; starts the counters
+perf_counters::perf_counters(void)
+{ _fds.fill(-1);
+
+  if (!perf_is_enabled)
+    return;
+
+  for (size_t n = 0; n < N_PERF_COUNTERS; ++n)
+  { _fds[n] = open_counter(n, _fds[0]);
+
+    if (_fds[n] == -1)                                  // all or nothing
+    { for (const int fd : _fds)
+        if (fd != -1)
+          ::close(fd);
+
+      _fds.fill(-1);
+      return;
+    }
+  }
+
+  ioctl(_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+/// destructor; releases the counters
+perf_counters::~perf_counters(void)
+{ for (const int fd : _fds)
+    if (fd != -1)
+      ::close(fd);
+}
+
+/*! \brief      The counts since construction
+    \return     the counts; invalid if the counters are not active
+*/
+perf_sample perf_counters::read(void) const
+{ perf_sample rv;
+
+  if (_fds[0] == -1)
+    return rv;
+
+  struct
+  { uint64_t nr;
+    uint64_t time_enabled;
+    uint64_t time_running;
+    uint64_t values[N_PERF_COUNTERS];
+  } buffer;
+
+  if (::read(_fds[0], &buffer, sizeof(buffer)) != static_cast<ssize_t>(sizeof(buffer)) or (buffer.nr != N_PERF_COUNTERS))
+    return rv;
+
+// if the counters were multiplexed with others, scale them to the whole of the interval
+  const double scale { (buffer.time_running == 0) ? 0.0 : static_cast<double>(buffer.time_enabled) / buffer.time_running };
+
+  for (size_t n = 0; n < N_PERF_COUNTERS; ++n)
+    rv.values[n] = static_cast<uint64_t>(buffer.values[n] * scale);
+
+  rv.valid = true;
+
+  return rv;
+}
@@ -0,0 +1,179 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-plan.cpp
+
+    Plans for builds whose output contains only some of the fields, or only some of the records
+*/
+
+#include "fcc-plan.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/// the names of the fields of the output, in order
+constexpr array<string_view, static_cast<size_t>(FCC::N_FIELDS)> FCC_FIELD_NAMES { "ID", "CALLSIGN", "OPERATOR_CLASS", "GROUP_CODE", "REGION_CODE",
+                                                                                    "TRUSTEE_CALLSIGN", "TRUSTEE_INDICATOR", "SYSTEMATIC_CALLSIGN_CHANGE",
+                                                                                    "VANITY_CALLSIGN_CHANGE", "VANITY_RELATIONSHIP", "PREVIOUS_CALLSIGN",
+                                                                                    "PREVIOUS_OPERATOR_CLASS", "TRUSTEE_NAME", "COMMENT_DATE", "DESCRIPTION",
+                                                                                    "CO_STATUS_CODE", "CO_STATUS_DATE", "ENTITY_NAME", "FIRST_NAME",
+                                                                                    "MIDDLE_INITIAL", "LAST_NAME", "SUFFIX", "PHONE", "FAX", "EMAIL",
+                                                                                    "STREET_ADDRESS", "CITY", "STATE", "ZIP_CODE", "PO_BOX", "ATTENTION_LINE",
+                                                                                    "FRN", "APPLICANT_TYPE_CODE", "APPLICANT_TYPE_CODE_OTHER", "EN_STATUS_CODE",
+                                                                                    "EN_STATUS_DATE", "LICENSE_STATUS", "RADIO_SERVICE_CODE", "GRANT_DATE",
+                                                                                    "EXPIRED_DATE", "CANCELLATION_DATE", "ELIGIBILITY_RULE_NUM", "REVOKED",
+                                                                                    "CONVICTED", "ADJUDGED", "EFFECTIVE_DATE", "LAST_ACTION_DATE",
+                                                                                    "LICENSEE_NAME_CHANGE", "LINKED_ID", "LINKED_CALLSIGN"
+                                                                                  };
+
+/*! \brief          Get the name of a field of the output
+    \param  field   the field
+    \return         the name of <i>field</i>, which is the same as that of the enumerator
+*/
+string_view fcc_field_name(const FCC field)
+  { return FCC_FIELD_NAMES.at(static_cast<size_t>(field)); }
+
+/*! \brief          Get a field of the output from its name
+    \param  name    the name of the field, in any case
+    \return         the field called <i>name</i>
+
+    Exits if there is no such field
+*/
+FCC fcc_field(const string& name)
+{ const string upper_name { to_upper(name) };
+  const auto   it         { ranges::find(FCC_FIELD_NAMES, upper_name) };
+
+  if (it == FCC_FIELD_NAMES.end())
+  { cerr << "Unknown field: " << name << endl;
+    exit(-1);
+  }
+
+  return static_cast<FCC>(it - FCC_FIELD_NAMES.begin());
+}
+
+// -----------  query_plan  ----------------
+
+/*!     \class query_plan
+        \brief which .DAT files and which of their fields must be read to produce a particular output
+*/
+
+/*! \brief          Constructor
+    \param  fields  comma-separated names of the output fields, in order; empty means every field
+    \param  where   comma-separated conditions of the form FIELD=VALUE, all of which a record must meet; empty means every record
+
+    Names of fields may be in any case; values are compared after conversion to upper case, as in the
+    records themselves. Dates are compared in the output format, YYYY-MM-DD. Exits if a field or a condition is invalid
+*/
+query_plan::query_plan(const string& fields, const string& where)
+{ if (!fields.empty())
+    for (const string& name : split_string(fields, ","s))
+    { _fields.push_back(fcc_field(remove_peripheral_spaces(name)));
+      _needed.set(static_cast<size_t>(_fields.back()));
+    }
+  else
+    _needed.set();
+
+  if (!where.empty())
+    for (const string& condition : split_string(where, ","s))
+    { const size_t posn { condition.find('=') };
+
+      if (posn == string::npos)
+      { cerr << "Invalid condition: " << condition << "; should be FIELD=VALUE" << endl;
+        exit(-1);
+      }
+
+      _where.push_back( { fcc_field(remove_peripheral_spaces(condition.substr(0, posn))), to_upper(remove_peripheral_spaces(condition.substr(posn + 1))) } );
+      _needed.set(static_cast<size_t>(_where.back().first));
+    }
+
+// the fields that define the output order, and that are used to resolve duplicates
+  for (const FCC field : { FCC::ID, FCC::CALLSIGN, FCC::LAST_ACTION_DATE })
+    _needed.set(static_cast<size_t>(field));
+}
+
+/*! \brief      Does a record meet the conditions?
+    \param  rec the record
+    \return     whether <i>rec</i> meets every condition
+*/
+bool query_plan::selects(const FCC_RECORD& rec) const
+  { return ranges::all_of(_where, [&rec] (const auto& condition) { return (rec[condition.first] == condition.second); }); }
+
+/*! \brief          Select the records that meet the conditions
+    \param  recs    records, in output order
+    \return         the records in <i>recs</i> that meet every condition, in the same order
+*/
+vector<const FCC_RECORD*> query_plan::select(const vector<const FCC_RECORD*>& recs) const
+{ if (_where.empty())
+    return recs;
+
+  vector<const FCC_RECORD*> rv;
+
+  ranges::copy_if(recs, back_inserter(rv), [this] (const FCC_RECORD* rec_p) { return selects(*rec_p); });
+
+  return rv;
+}
+
+/*! \brief          Append the output fields of a record to a string
+    \param  rec     the record
+    \param  str     the string to which the fields are appended, separated by "|"
+*/
+void query_plan::append_to(const FCC_RECORD& rec, string& str) const
+{ if (_fields.empty())
+  { rec.append_to(str);
+    return;
+  }
+
+  for (size_t n = 0; n < _fields.size(); ++n)
+  { if (n)
+      str += '|';
+
+    str += rec[_fields[n]];
+  }
+}
+
+/*! \brief          Convert some records to a string
+    \param  recs    the records to convert, in the order in which they are to appear
+    \return         the output fields of <i>recs</i>, one record per line
+*/
+string query_plan::to_string(const vector<const FCC_RECORD*>& recs) const
+{ string rv;
+
+  for (const FCC_RECORD* rec_p : recs)
+  { append_to(*rec_p, rv);
+    rv += '\n';
+  }
+
+  return rv;
+}
+
+/// a one-line description of the plan, for --stats
+string query_plan::description(void) const
+{ string rv { "plan:"s };
+
+  auto describe { [this, &rv] <::mergeable T> (void)
+                    { rv += " "s + merge_traits<T>::name;
+
+                      if (needs<T>())
+                        rv += " ("s + ::to_string(columns<T>().count()) + "/"s + ::to_string(static_cast<size_t>(T::N_FIELDS)) + " fields)"s;
+                      else
+                        rv += " (skipped)"s;
+                    } };
+
+  describe.template operator()<AM>();
+  describe.template operator()<CO>();
+  describe.template operator()<EN>();
+  describe.template operator()<HD>();
+
+  rv += "; output "s + ::to_string(_fields.empty() ? static_cast<size_t>(FCC::N_FIELDS) : _fields.size()) + " fields"s;
+
+  if (!_where.empty())
+    rv += ", "s + ::to_string(_where.size()) + " condition"s + (_where.size() == 1 ? ""s : "s"s);
+
+  return rv;
+}
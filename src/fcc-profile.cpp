@@ -0,0 +1,172 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-profile.cpp
+
+    Profiles of the fields in FCC .DAT files: lengths, cardinalities and null rates
+*/
+
+#include "fcc-profile.h"
+
+#include <bit>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+/*! \brief      Mix the bits of a hash
+    \param  h   hash
+    \return     <i>h</i>, passed through the splitmix64 finaliser
+
+    HyperLogLog needs every bit of the hash to be uniformly distributed; std::hash makes no such promise
+*/
+static inline uint64_t mix64(uint64_t h)
+{ h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+
+  return h ^ (h >> 31);
+}
+
+// -----------  hyperloglog  ----------------
+
+/*!     \class hyperloglog
+        \brief estimate the number of distinct values in a stream, in constant space
+*/
+
+/*! \brief          Add a value
+    \param  str     the value
+*/
+void hyperloglog::add(const string_view str)
+{ const uint64_t h    { mix64(hash<string_view> { }(str)) };
+  const uint64_t rest { h << HLL_PRECISION };                                                   // the bits not used to choose the register
+  const uint8_t  rank { static_cast<uint8_t>( rest ? countl_zero(rest) + 1 : 64 - HLL_PRECISION + 1 ) };
+
+  uint8_t& reg { _registers[h >> (64 - HLL_PRECISION)] };
+
+  reg = max(reg, rank);
+}
+
+/// the estimated number of distinct values added
+double hyperloglog::estimate(void) const
+{ constexpr double m     { 1 << HLL_PRECISION };
+  constexpr double alpha { 0.7213 / (1 + 1.079 / m) };
+
+  double sum    { 0 };
+  size_t n_zero { 0 };
+
+  for (const uint8_t reg : _registers)
+  { sum += ldexp(1.0, -reg);
+
+    if (reg == 0)
+      n_zero++;
+  }
+
+  const double raw { alpha * m * m / sum };
+
+  return ( ((raw <= 2.5 * m) and n_zero) ? m * log(m / n_zero) : raw );     // linear counting is more accurate for small cardinalities
+}
+
+// -----------  length_histogram  ----------------
+
+/*!     \class length_histogram
+        \brief the distribution of the lengths of a field
+*/
+
+/*! \brief      The length below or at which a proportion of the values lie
+    \param  q   the proportion, in the range [0, 1]
+    \return     the <i>q</i>th quantile of the lengths; if that falls in the last bin, the greatest length
+*/
+size_t length_histogram::percentile(const double q) const
+{ if (_n == 0)
+    return 0;
+
+  const uint64_t target { std::max(static_cast<uint64_t>(ceil(q * _n)), static_cast<uint64_t>(1)) };
+
+  uint64_t cumulative { 0 };
+
+  for (size_t len = 0; len < PROFILE_LENGTH_BINS; ++len)
+  { cumulative += _bins[len];
+
+    if (cumulative >= target)
+      return len;
+  }
+
+  return _max;
+}
+
+/*! \brief              Profile a .DAT file
+    \param  fn          name of the file
+    \param  contents    contents of the file
+    \return             the profile of the fields of <i>fn</i>
+
+    The type of the records is taken from the first two characters of the name of the file. Throws
+    exception if the type is unknown
+*/
+file_profile profile_file(const string& fn, const string& contents)
+{ const string base_fn { fn.substr(fn.find_last_of('/') + 1) };
+  const string type    { to_upper(base_fn.substr(0, 2)) };
+
+  if (type == "AM"s)
+    return profile_records(base_fn, AM_VIEW(contents));
+
+  if (type == "CO"s)
+    return profile_records(base_fn, CO_VIEW(contents));
+
+  if (type == "EN"s)
+    return profile_records(base_fn, EN_VIEW(contents));
+
+  if (type == "HD"s)
+    return profile_records(base_fn, HD_VIEW(contents));
+
+  if (type == "HS"s)
+    return profile_records(base_fn, HS_VIEW(contents));
+
+  if (type == "LA"s)
+    return profile_records(base_fn, LA_VIEW(contents));
+
+  if (type == "SC"s)
+    return profile_records(base_fn, SC_VIEW(contents));
+
+  if (type == "SF"s)
+    return profile_records(base_fn, SF_VIEW(contents));
+
+  cerr << "Unknown type of .DAT file: " << fn << endl;
+  throw exception();
+}
+
+/*! \brief              Write profiles as tables
+    \param  ost         stream to which the tables are written
+    \param  profiles    the profiles
+
+    Fields are identified by their positions, as in the FCC's definitions of the .DAT files
+*/
+void print_profiles(ostream& ost, const vector<file_profile>& profiles)
+{ char buf[200];
+
+  for (const file_profile& fp : profiles)
+  { const double n_recs { static_cast<double>(max(fp.n_records, static_cast<uint64_t>(1))) };
+
+    snprintf(buf, sizeof(buf), "%s: %llu records, %llu multi-line (%.3f%%)", fp.name.c_str(), static_cast<unsigned long long>(fp.n_records),
+             static_cast<unsigned long long>(fp.n_multi_line), 100.0 * fp.n_multi_line / n_recs);
+    ost << buf << endl;
+
+    snprintf(buf, sizeof(buf), "%5s %6s %6s %6s %6s %6s %9s %12s %8s", "field", "max", "p50", "p90", "p99", "p99.9", "empty(%)", "distinct", "LF");
+    ost << buf << endl;
+
+    for (size_t n = 0; n < fp.fields.size(); ++n)
+    { const field_profile& field { fp.fields[n] };
+
+      snprintf(buf, sizeof(buf), "%5zu %6zu %6zu %6zu %6zu %6zu %9.2f %12.0f %8llu", n + 1, field.lengths.max(), field.lengths.percentile(0.5),
+               field.lengths.percentile(0.9), field.lengths.percentile(0.99), field.lengths.percentile(0.999), 100.0 * field.n_empty / n_recs,
+               field.distinct.estimate(), static_cast<unsigned long long>(field.n_line_feeds));
+      ost << buf << endl;
+    }
+
+    ost << endl;
+  }
+}
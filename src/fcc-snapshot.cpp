@@ -0,0 +1,238 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-snapshot.cpp
+
+    Binary snapshots of merged records
+*/
+
+#include "fcc-snapshot.h"
+
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <queue>
+
+using namespace std;
+
+// -----------  snapshot_writer  ----------------
+
+/*!     \class snapshot_writer
+        \brief write records to a snapshot, one at a time
+*/
+
+/*! \brief              Constructor
+    \param  filename    name of the snapshot file
+
+    Throws exception if the file cannot be opened
+*/
+snapshot_writer::snapshot_writer(const string& filename) :
+  _filename(filename),
+  _ofs(filename, ios::binary)
+{ if (!_ofs)
+  { cerr << ("Cannot open snapshot file: "s + filename) << endl;
+    throw exception();
+  }
+
+  _ofs.write(reinterpret_cast<const char*>(&_header), sizeof(_header));     // placeholder; rewritten by close()
+}
+
+/// destructor; closes the snapshot if necessary
+snapshot_writer::~snapshot_writer(void)
+{ if (!_closed)
+  { try
+    { close();
+    }
+
+    catch (...)
+    { }
+  }
+}
+
+/*! \brief      Add a record to the snapshot
+    \param  rec record to be added
+
+    Throws exception if a field is too long to be stored
+*/
+void snapshot_writer::operator+=(const FCC_RECORD& rec)
+{ for (size_t n = 0; n < static_cast<size_t>(FCC::N_FIELDS); ++n)
+  { const string& field { rec[static_cast<int>(n)] };
+
+    if (field.size() > numeric_limits<uint16_t>::max())
+    { cerr << "Field too long for snapshot in record with ID: " << rec[FCC::ID] << endl;
+      throw exception();
+    }
+
+    const uint16_t len { static_cast<uint16_t>(field.size()) };
+
+    _ofs.write(reinterpret_cast<const char*>(&len), sizeof(len));
+    _ofs.write(field.data(), len);
+  }
+
+  _header.n_records++;
+}
+
+/*! \brief  Complete the snapshot
+
+    Throws exception if the file cannot be written
+*/
+void snapshot_writer::close(void)
+{ _closed = true;
+
+  _ofs.seekp(0);
+  _ofs.write(reinterpret_cast<const char*>(&_header), sizeof(_header));
+  _ofs.close();
+
+  if (!_ofs)
+  { cerr << ("Error writing snapshot file: "s + _filename) << endl;
+    throw exception();
+  }
+}
+
+// -----------  snapshot_reader  ----------------
+
+/*!     \class snapshot_reader
+        \brief read records from a snapshot, one at a time
+*/
+
+/*! \brief              Constructor
+    \param  filename    name of the snapshot file
+
+    Throws exception if the file cannot be mapped or is not a snapshot
+*/
+snapshot_reader::snapshot_reader(const string& filename) :
+  _file(filename)
+{ snapshot_header header;
+
+  if (_file.size() >= sizeof(header))
+    memcpy(&header, _file.contents().data(), sizeof(header));
+
+  if ( (_file.size() < sizeof(header)) or (header.magic != SNAPSHOT_MAGIC) or (header.n_fields != static_cast<uint32_t>(FCC::N_FIELDS)) )
+  { cerr << ("Invalid snapshot file: "s + filename) << endl;
+    throw exception();
+  }
+
+  _posn      = sizeof(header);
+  _remaining = header.n_records;
+}
+
+/*! \brief      Read the next record
+    \param  rec destination for the record
+    \return     whether a record was read
+
+    Throws exception if the snapshot is truncated
+*/
+bool snapshot_reader::next(FCC_RECORD& rec)
+{ if (_remaining == 0)
+    return false;
+
+  const string_view contents { _file.contents() };
+
+  for (size_t n = 0; n < static_cast<size_t>(FCC::N_FIELDS); ++n)
+  { uint16_t len;
+
+    if (_posn + sizeof(len) > contents.size())
+    { cerr << "Truncated snapshot file" << endl;
+      throw exception();
+    }
+
+    memcpy(&len, contents.data() + _posn, sizeof(len));
+    _posn += sizeof(len);
+
+    if (_posn + len > contents.size())
+    { cerr << "Truncated snapshot file" << endl;
+      throw exception();
+    }
+
+    rec[static_cast<FCC>(n)].assign(contents.data() + _posn, len);
+    _posn += len;
+  }
+
+  _remaining--;
+
+  return true;
+}
+
+/*! \brief              Write records to a snapshot
+    \param  filename    name of the snapshot file
+    \param  recs        the records, in the order defined by compare_records()
+*/
+void write_snapshot(const string& filename, const vector<const FCC_RECORD*>& recs)
+{ snapshot_writer writer(filename);
+
+  for (const FCC_RECORD* rec_p : recs)
+    writer += *rec_p;
+
+  writer.close();
+}
+
+/*! \brief              Merge snapshots
+    \param  filenames   names of the snapshot files
+    \param  fn          function to be called for each record, in the order defined by compare_records()
+    \param  duplicates  what to do with records that have the same call
+
+    The snapshots may be the result of building different ranges of IDs; the records passed to <i>fn</i>
+    are the same as would have been output by a single build with the same value of <i>duplicates</i>
+*/
+void combine_snapshots(const vector<string>& filenames, const function<void(const FCC_RECORD&)>& fn, const DUPLICATES duplicates)
+{ vector<unique_ptr<snapshot_reader>> readers;
+  vector<FCC_RECORD>                  current(filenames.size());     // the next record from each reader
+  vector<keyed_record>                current_keyed(filenames.size());   // the next record from each reader, with the key of its call
+
+  for (const string& filename : filenames)
+    readers.push_back(make_unique<snapshot_reader>(filename));
+
+// k-way merge: the heap holds the index of each reader that has a current record
+  auto later { [&current_keyed] (const size_t n1, const size_t n2) { return compare_records(current_keyed[n2], current_keyed[n1]); } };
+
+  priority_queue<size_t, vector<size_t>, decltype(later)> heap(later);
+
+// read the next record from a reader, and compute the key of its call once
+  auto advance { [&] (const size_t n)
+                   { if (readers[n]->next(current[n]))
+                     { current_keyed[n] = keyed_record(current[n]);
+                       heap.push(n);
+                     }
+                   } };
+
+  for (size_t n = 0; n < readers.size(); ++n)
+    advance(n);
+
+  duplicate_reporter reporter(cerr);
+
+  callsign_key last_key;
+  string       last_call;           // used only if the call is too long to be represented exactly by its key
+  bool         first { true };
+
+  while (!heap.empty())
+  { const size_t n { heap.top() };
+
+    heap.pop();
+
+    const keyed_record& kr  { current_keyed[n] };
+    const FCC_RECORD&   rec { current[n] };
+
+    if (duplicates == DUPLICATES::REPORT)
+      reporter += kr;
+
+    if ( (duplicates == DUPLICATES::ALL) or first or (kr.key != last_key) or (!kr.key.exact() and (rec[FCC::CALLSIGN] != last_call)) )   // the first record of a call is the newest
+    { fn(rec);
+      last_key = kr.key;
+
+      if (!kr.key.exact())
+        last_call = rec[FCC::CALLSIGN];
+
+      first = false;
+    }
+
+    advance(n);
+  }
+
+  if (duplicates == DUPLICATES::REPORT)
+    reporter.close();
+}
@@ -0,0 +1,225 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-stats.cpp
+
+    Timing and throughput of the stages of processing
+*/
+
+#include "fcc-stats.h"
+#include "fcc-trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+
+#include <sys/resource.h>
+#include <time.h>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr seconds PROGRESS_INTERVAL { 5 };            ///< minimum time between progress reports for a stage
+
+static atomic<bool>         stats_are_enabled { false };
+static mutex                results_mutex;
+static vector<stage_result> results;                  ///< protected by results_mutex
+
+/// enable or disable the reporting of statistics
+void enable_stats(const bool b)
+  { stats_are_enabled = b; }
+
+/// have statistics been enabled?
+bool stats_enabled(void)
+  { return stats_are_enabled; }
+
+/// the results of all completed stages, in the order in which they completed
+vector<stage_result> stage_results(void)
+{ lock_guard<mutex> lock(results_mutex);
+
+  return results;
+}
+
+/// discard the results of all completed stages
+void clear_stage_results(void)
+{ lock_guard<mutex> lock(results_mutex);
+
+  results.clear();
+}
+
+/// the peak resident set size of the process, in KiB
+long peak_rss_kib(void)
+{ struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+
+  return usage.ru_maxrss;
+}
+
+/// the CPU time consumed by the calling thread, in seconds
+double thread_cpu_seconds(void)
+{ struct timespec ts;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// -----------  stage_timer  ----------------
+
+/*!     \class stage_timer
+        \brief measure a stage of processing, from construction until stop() or destruction
+*/
+
+/*! \brief          Constructor; starts the stage
+    \param  name    name of the stage
+*/
+stage_timer::stage_timer(const string& name) :
+  _name(name),
+  _start(steady_clock::now()),
+  _last_progress(_start),
+  _cpu_start(thread_cpu_seconds()),
+  _rss_start(peak_rss_kib()),
+  _outer_peak(reset_peak_alloc_bytes())
+{ _allocs_start = thread_alloc_counts();
+}
+
+/// report progress if statistics have been enabled and it is time to do so
+void stage_timer::progress(void)
+{ if (!stats_are_enabled)
+    return;
+
+  const auto now { steady_clock::now() };
+
+  if (now - _last_progress < PROGRESS_INTERVAL)
+    return;
+
+  _last_progress = now;
+
+  const double elapsed { duration<double>(now - _start).count() };
+
+  char buf[160];
+
+  if (_ticks)
+    snprintf(buf, sizeof(buf), "[%s] %llu of %llu records in %.1f s", _name.c_str(), static_cast<unsigned long long>(_ticks), static_cast<unsigned long long>(_records), elapsed);
+  else
+    snprintf(buf, sizeof(buf), "[%s] %llu records, %.1f MB in %.1f s", _name.c_str(), static_cast<unsigned long long>(_records), _bytes / 1e6, elapsed);
+  cerr << buf << endl;
+}
+
+/// stop the stage and record its result; does nothing if the stage has already been stopped
+void stage_timer::stop(void)
+{ if (_stopped)
+    return;
+
+  _stopped = true;
+
+  const perf_sample  perf       { _perf.read() };
+  const alloc_counts allocs_now { thread_alloc_counts() };
+  const auto         now        { steady_clock::now() };
+
+  const alloc_counts allocs { allocs_now.n_allocs - _allocs_start.n_allocs,
+                              allocs_now.bytes - _allocs_start.bytes,
+                              allocs_now.live_bytes - _allocs_start.live_bytes,
+                              allocs_now.peak_bytes - _allocs_start.live_bytes
+                            };
+
+  restore_peak_alloc_bytes(_outer_peak);     // so that an enclosing stage on this thread sees the peak within this stage
+
+  trace_span(_name, _start, now);
+
+  const stage_result result { _name,
+                              duration<double>(now - _start).count(),
+                              thread_cpu_seconds() - _cpu_start,
+                              _bytes,
+                              _records,
+                              peak_rss_kib() - _rss_start,
+                              perf,
+                              allocs
+                            };
+
+  lock_guard<mutex> lock(results_mutex);
+
+  results.push_back(result);
+}
+
+/*! \brief      Print a table of the results of all completed stages
+    \param  ost stream to which the table is written
+
+    If allocations were tracked, or the hardware counters were enabled, further tables contain
+    the counts for each stage
+*/
+void print_stats(ostream& ost)
+{ char buf[200];
+
+  const vector<stage_result> all_results { stage_results() };
+
+  snprintf(buf, sizeof(buf), "%-24s %9s %9s %10s %10s %9s %12s", "stage", "wall(s)", "cpu(s)", "MB", "records", "MB/s", "RSS+(MiB)");
+  ost << buf << endl;
+
+  for (const stage_result& result : all_results)
+  { const double mb      { result.bytes / 1e6 };
+    const double mb_rate { (result.wall_seconds > 0) ? mb / result.wall_seconds : 0 };
+
+    snprintf(buf, sizeof(buf), "%-24s %9.3f %9.3f %10.1f %10llu %9.1f %12.1f", result.name.c_str(), result.wall_seconds, result.cpu_seconds,
+             mb, static_cast<unsigned long long>(result.records), mb_rate, result.rss_delta_kib / 1024.0);
+    ost << buf << endl;
+  }
+
+  snprintf(buf, sizeof(buf), "peak RSS: %.1f MiB", peak_rss_kib() / 1024.0);
+  ost << buf << endl;
+
+  if (alloc_tracking_enabled())
+  { ost << endl;
+    snprintf(buf, sizeof(buf), "%-24s %12s %12s %14s %12s %12s", "stage", "allocs", "MB alloc", "peak live(MB)", "allocs/rec", "bytes/rec");
+    ost << buf << endl;
+
+    for (const stage_result& result : all_results)
+    { const double n_recs { static_cast<double>(max(result.records, static_cast<uint64_t>(1))) };
+
+      snprintf(buf, sizeof(buf), "%-24s %12llu %12.1f %14.1f %12.2f %12.1f", result.name.c_str(), static_cast<unsigned long long>(result.allocs.n_allocs),
+               result.allocs.bytes / 1e6, result.allocs.peak_bytes / 1e6, result.allocs.n_allocs / n_recs, result.allocs.bytes / n_recs);
+      ost << buf << endl;
+    }
+  }
+
+  if (none_of(all_results.begin(), all_results.end(), [] (const stage_result& result) { return result.perf.valid; }))
+    return;
+
+  ost << endl;
+  snprintf(buf, sizeof(buf), "%-24s %12s %12s %6s %12s %12s %10s %10s", "stage", "Mcycles", "Minstr", "IPC", "cache-miss", "branch-miss", "cm/rec", "bm/rec");
+  ost << buf << endl;
+
+  perf_sample total;
+
+  for (const stage_result& result : all_results)
+  { if (!result.perf.valid)
+      continue;
+
+    total += result.perf;
+
+    const perf_sample& ps       { result.perf };
+    const double       cycles   { static_cast<double>(ps[PERF_COUNTER::CYCLES]) };
+    const double       ipc      { (cycles > 0) ? ps[PERF_COUNTER::INSTRUCTIONS] / cycles : 0 };
+    const double       n_recs   { static_cast<double>(max(result.records, static_cast<uint64_t>(1))) };
+
+    snprintf(buf, sizeof(buf), "%-24s %12.1f %12.1f %6.2f %12llu %12llu %10.2f %10.2f", result.name.c_str(), cycles / 1e6, ps[PERF_COUNTER::INSTRUCTIONS] / 1e6, ipc,
+             static_cast<unsigned long long>(ps[PERF_COUNTER::CACHE_MISSES]), static_cast<unsigned long long>(ps[PERF_COUNTER::BRANCH_MISSES]),
+             ps[PERF_COUNTER::CACHE_MISSES] / n_recs, ps[PERF_COUNTER::BRANCH_MISSES] / n_recs);
+    ost << buf << endl;
+  }
+
+  const double total_cycles { static_cast<double>(total[PERF_COUNTER::CYCLES]) };
+
+  snprintf(buf, sizeof(buf), "%-24s %12.1f %12.1f %6.2f %12llu %12llu", "total", total_cycles / 1e6, total[PERF_COUNTER::INSTRUCTIONS] / 1e6,
+           (total_cycles > 0) ? total[PERF_COUNTER::INSTRUCTIONS] / total_cycles : 0,
+           static_cast<unsigned long long>(total[PERF_COUNTER::CACHE_MISSES]), static_cast<unsigned long long>(total[PERF_COUNTER::BRANCH_MISSES]));
+  ost << buf << endl;
+}
@@ -17,10 +17,21 @@
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <fstream>
 #include <iostream>
 
+#include <cerrno>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -49,6 +60,35 @@ vector<string> split_string(const string& cs, const string& separator)
   return rv;
 }
 
+/*! \brief              Split a string into components, without allocating
+    \param  sv          original string
+    \param  separator   separator character
+    \param  fields      storage for the components, which refer to <i>sv</i>
+    \return             the number of components in <i>sv</i>
+
+    If <i>sv</i> has more components than <i>fields</i> can hold, only the first <i>fields.size()</i> are stored.
+    Unlike the other split_string(), a trailing separator implies an empty final component
+*/
+size_t split_string(const string_view sv, const char separator, const span<string_view> fields)
+{ size_t n_fields   { 0 };
+  size_t start_posn { 0 };
+
+  while (true)
+  { const size_t posn { sv.find(separator, start_posn) };
+    const size_t end  { (posn == string_view::npos) ? sv.size() : posn };
+
+    if (n_fields < fields.size())
+      fields[n_fields] = sv.substr(start_posn, end - start_posn);
+
+    n_fields++;
+
+    if (posn == string_view::npos)
+      return n_fields;
+
+    start_posn = posn + 1;
+  }
+}
+
 /*! \brief              Read the contents of a file into a single string
     \param  filename    name of file to be read
     \return             contents of file <i>filename</i>
@@ -57,38 +97,103 @@ vector<string> split_string(const string& cs, const string& separator)
     of several bad things happen. Assumes that the file is a reasonable length.
 */
 string read_file(const string& filename)
-{ FILE* fp { fopen(filename.c_str(), "rb") };
+{ const int fd { ::open(filename.c_str(), O_RDONLY) };
 
-  if (!fp)
+  if (fd < 0)
   { cerr << ("Cannot open file: "s + filename) << endl;
     throw exception();
   }
-  else
-    fclose(fp);
 
 // check that the file is not a directory  
   struct stat stat_buffer;
 
-  const int status { ::stat(filename.c_str(), &stat_buffer) };
+  const int status { fstat(fd, &stat_buffer) };
 
   if (status)
-  { cerr << ("Unable to stat file: "s + filename) << endl;;
+  { ::close(fd);
+    cerr << ("Unable to stat file: "s + filename) << endl;;
     throw exception();
   }
 
-  const bool is_directory { ( (stat_buffer.st_mode bitand S_IFDIR) != 0 ) };
+  const bool is_directory { S_ISDIR(stat_buffer.st_mode) };
 
   if (is_directory)
-  { cerr << (filename + " is a directory"s) << endl;
+  { ::close(fd);
+    cerr << (filename + " is a directory"s) << endl;
     throw exception();
   }
 
-  ifstream file { filename };
-  string   str  {std::istreambuf_iterator<char>(file), {} };
+// read the whole file with as few system calls as possible
+  string str(static_cast<size_t>(stat_buffer.st_size), '\0');
+  size_t done { 0 };
+
+  while (done < str.size())
+  { const ssize_t n_read { ::read(fd, str.data() + done, str.size() - done) };
+
+    if (n_read < 0)
+    { if (errno == EINTR)
+        continue;
+
+      ::close(fd);
+      cerr << ("Error reading file: "s + filename) << endl;
+      throw exception();
+    }
+
+    if (n_read == 0)                    // the file has become shorter
+      break;
+
+    done += static_cast<size_t>(n_read);
+  }
+
+  ::close(fd);
+  str.resize(done);
 
   return str;
 }
 
+/*! \brief              Write a string to a file, atomically
+    \param  filename    name of file to be written
+    \param  contents    the string to write
+
+    The string is written to a temporary file in the same directory, which is then renamed,
+    so that a reader never sees a partial file. Throws exception on error
+*/
+void write_file_atomically(const string& filename, const string_view contents)
+{ const string tmp_filename { filename + ".tmp."s + to_string(getpid()) };
+
+  const int fd { ::open(tmp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) };
+
+  if (fd < 0)
+  { cerr << ("Cannot open file: "s + tmp_filename) << endl;
+    throw exception();
+  }
+
+  size_t done { 0 };
+
+  while (done < contents.size())
+  { const ssize_t n { ::write(fd, contents.data() + done, contents.size() - done) };
+
+    if (n < 0)
+    { if (errno == EINTR)
+        continue;
+
+      break;
+    }
+
+    done += static_cast<size_t>(n);
+  }
+
+  const bool written { (done == contents.size()) and (fsync(fd) == 0) };
+
+  ::close(fd);
+
+  if (!written or (rename(tmp_filename.c_str(), filename.c_str()) != 0))
+  { unlink(tmp_filename.c_str());
+    cerr << ("Error writing file: "s + filename) << endl;
+    throw exception();
+  }
+}
+
 /*! \brief                  Remove all instances of a particular char from a string
     \param  cs              original string
     \param  char_to_remove  character to be removed from <i>cs</i>
@@ -97,7 +202,7 @@ string read_file(const string& filename)
 string remove_char(const string& cs, const char char_to_remove)
 { string rv { cs };
 
-  rv.erase( remove(rv.begin(), rv.end(), char_to_remove), rv.end() );
+  remove_char_in_place(rv, char_to_remove);
 
   return rv;
 } 
@@ -110,23 +215,233 @@ string remove_char(const string& cs, const char char_to_remove)
 string transform_string(const string& cs, int(*pf)(int))
 { string rv = cs;
   
-  transform(rv.begin(), rv.end(), rv.begin(), pf);
+  transform_in_place(rv, pf);
   
   return rv;
 }
 
-/*! \brief      Transform an FCC date to an ISO 8601 extended-format date
-    \param  cs  original string
+/*! \brief      Transform a string, in place
+    \param  str string to be modified
     \param  pf  pointer to transformation function
-    \return     <i>cs</i> with the transformation <i>*pf</i> applied
+*/
+void transform_in_place(const span<char> str, int(*pf)(int))
+  { transform(str.begin(), str.end(), str.begin(), pf); }
+
+/*! \brief      Convert string to upper case
+    \param  cs  original string
+    \return     <i>cs</i> with the ASCII letters and the UTF-8 Latin-1 letters converted to upper case
+
+    Other octets are left unchanged, so that UTF-8 sequences are preserved (std::toupper
+    is undefined for negative values of char)
+*/
+string to_upper(const string& cs)
+{ string rv { cs };
+
+  to_upper_in_place(rv);
+
+  return rv;
+}
+
+/*! \brief      Convert string to upper case, in place
+    \param  str string to be modified
+
+    The conversion is the same as that performed by to_upper()
+*/
+void to_upper_in_place(const span<char> str)
+{ for (size_t n = 0; n < str.size(); ++n)
+  { char& c { str[n] };
+
+    if ( (c >= 'a') and (c <= 'z') )
+      c -= ('a' - 'A');
+    else if ( (c == '\xC3') and (n + 1 < str.size()) )         // U+00E0 to U+00FE, except U+00F7 (division sign), have upper-case forms 0x20 lower
+    { const unsigned char next { static_cast<unsigned char>(str[n + 1]) };
+
+      if ( (next >= 0xA0) and (next <= 0xBE) and (next != 0xB7) )
+        str[++n] -= 0x20;
+    }
+  }
+}
+
+/*! \brief      The number of leading ASCII octets in a string
+    \param  sv  string to test
+    \return     the position of the first octet in <i>sv</i> that is not ASCII; the length of <i>sv</i> if there is none
+*/
+static size_t ascii_prefix_length(const string_view sv)
+{ size_t posn { 0 };
+
+#if defined(__SSE2__)
+  for ( ; posn + 16 <= sv.size(); posn += 16)
+  { const int mask { _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sv.data() + posn))) };     // the top bit of each octet
+
+    if (mask)
+      return posn + countr_zero(static_cast<unsigned int>(mask));
+  }
+#endif
+
+  while ( (posn < sv.size()) and !(sv[posn] & 0x80) )
+    posn++;
+
+  return posn;
+}
+
+/*! \brief      Is a string pure ASCII?
+    \param  sv  string to test
+    \return     whether every octet in <i>sv</i> is less than 0x80
+
+    Tests 16 octets at a time
+*/
+bool is_ascii(const string_view sv)
+  { return (ascii_prefix_length(sv) == sv.size()); }
+
+/*! \brief          The length of a valid UTF-8 sequence
+    \param  sv      string
+    \param  posn    position in <i>sv</i> at which the sequence starts
+    \return         the number of octets in the valid UTF-8 sequence that starts at <i>posn</i>; zero if the sequence is invalid
+*/
+static size_t utf8_sequence_length(const string_view sv, const size_t posn)
+{ const auto octet { [&sv] (const size_t n) { return static_cast<unsigned char>(sv[n]); } };
+
+  const unsigned char lead { octet(posn) };
+
+  if (lead < 0x80)
+    return 1;
+
+// the range of the second octet depends on the first; see table 3-7 of the Unicode standard
+  size_t        len;
+  unsigned char lo { 0x80 };
+  unsigned char hi { 0xBF };
+
+  if ( (lead >= 0xC2) and (lead <= 0xDF) )
+    len = 2;
+  else if ( (lead >= 0xE0) and (lead <= 0xEF) )
+  { len = 3;
+
+    if (lead == 0xE0)
+      lo = 0xA0;                      // overlong
+    else if (lead == 0xED)
+      hi = 0x9F;                      // surrogates
+  }
+  else if ( (lead >= 0xF0) and (lead <= 0xF4) )
+  { len = 4;
+
+    if (lead == 0xF0)
+      lo = 0x90;                      // overlong
+    else if (lead == 0xF4)
+      hi = 0x8F;                      // above U+10FFFF
+  }
+  else
+    return 0;
+
+  if (posn + len > sv.size())
+    return 0;
+
+  if ( (octet(posn + 1) < lo) or (octet(posn + 1) > hi) )
+    return 0;
+
+  for (size_t n = 2; n < len; ++n)
+    if ( (octet(posn + n) & 0xC0) != 0x80 )
+      return 0;
+
+  return len;
+}
+
+/*! \brief      Is a string valid UTF-8?
+    \param  sv  string to test
+    \return     whether <i>sv</i> is valid UTF-8
+
+    Overlong encodings, surrogates and code points above U+10FFFF are invalid. Runs of ASCII are skipped 16 octets at a time
+*/
+bool is_valid_utf8(const string_view sv)
+{ size_t posn { 0 };
+
+  while ( (posn += ascii_prefix_length(sv.substr(posn))) < sv.size() )
+  { const size_t len { utf8_sequence_length(sv, posn) };
+
+    if (len == 0)
+      return false;
+
+    posn += len;
+  }
+
+  return true;
+}
+
+/*! \brief      Repair a string that is not valid UTF-8
+    \param  sv  original string
+    \return     <i>sv</i>, with each octet that is not part of a valid UTF-8 sequence transcoded from CP1252 to UTF-8
+
+    CP1252 is a superset of the printable characters of Latin-1; the five octets that it leaves undefined become U+FFFD
+*/
+string repair_utf8(const string_view sv)
+{ constexpr array<char16_t, 32> CP1252_80_9F { u'\u20AC', u'\uFFFD', u'\u201A', u'\u0192', u'\u201E', u'\u2026', u'\u2020', u'\u2021',
+                                               u'\u02C6', u'\u2030', u'\u0160', u'\u2039', u'\u0152', u'\uFFFD', u'\u017D', u'\uFFFD',
+                                               u'\uFFFD', u'\u2018', u'\u2019', u'\u201C', u'\u201D', u'\u2022', u'\u2013', u'\u2014',
+                                               u'\u02DC', u'\u2122', u'\u0161', u'\u203A', u'\u0153', u'\uFFFD', u'\u017E', u'\u0178'
+                                             };
+
+  string rv;
+
+  rv.reserve(sv.size() + sv.size() / 2);
+
+  size_t posn { 0 };
+
+  while (posn < sv.size())
+  { const size_t len { utf8_sequence_length(sv, posn) };
+
+    if (len)
+    { rv.append(sv.substr(posn, len));
+      posn += len;
+      continue;
+    }
+
+    const unsigned char c          { static_cast<unsigned char>(sv[posn++]) };
+    const char16_t      code_point { (c < 0xA0) ? CP1252_80_9F[c - 0x80] : static_cast<char16_t>(c) };    // 0xA0 to 0xFF are the same as in Latin-1
+
+    if (code_point < 0x800)
+    { rv += static_cast<char>(0xC0 | (code_point >> 6));
+      rv += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else
+    { rv += static_cast<char>(0xE0 | (code_point >> 12));
+      rv += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+      rv += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+  }
+
+  return rv;
+}
+
+/*! \brief              Transform an FCC date to an ISO 8601 extended-format date
+    \param  us_date     original date, as MM/DD/YYYY
+    \return             <i>us_date</i> as YYYY-MM-DD
 */
 string transform_date(const string& us_date)
+{ array<char, ISO_DATE_LENGTH> iso_date;
+
+  return string(transform_date(us_date, iso_date));
+}
+
+/*! \brief              Transform an FCC date to an ISO 8601 extended-format date, in a buffer
+    \param  us_date     original date, as MM/DD/YYYY
+    \param  iso_date    storage for the result
+    \return             <i>us_date</i> as YYYY-MM-DD, in <i>iso_date</i>
+*/
+string_view transform_date(const string_view us_date, const span<char, ISO_DATE_LENGTH> iso_date)
 { if (us_date.size() != 10)
   { cout << "Error in date: *" << us_date << "*" << endl;
     exit(-1);
   }
-  
-  return ( us_date.substr(6, 4) + "-"s + us_date.substr(0, 2) + "-"s + us_date.substr(3, 2) );
+
+  const auto out { copy_n(us_date.data() + 6, 4, iso_date.data()) };      // YYYY
+
+  out[0] = '-';
+  out[1] = us_date[0];
+  out[2] = us_date[1];
+  out[3] = '-';
+  out[4] = us_date[3];
+  out[5] = us_date[4];
+
+  return string_view(iso_date.data(), iso_date.size());
 }
 
 /*! \brief          Is one call earlier than another, according to classical callsign sort order?
@@ -192,6 +507,24 @@ bool compare_calls(const string& call1, const string& call2)
 
   return (l1 < l2);
 }
+
+/*! \brief          Get the prefix of a call
+    \param  call    callsign
+    \return         the leading letters of <i>call</i> followed by the digits that follow them
+
+    For example, "KL7" for KL7ABC. Returns the empty string if <i>call</i> is empty
+*/
+string callsign_prefix(const string& call)
+{ size_t posn { 0 };
+
+  while ( (posn < call.size()) and isalpha(call[posn]) )
+    posn++;
+
+  while ( (posn < call.size()) and isdigit(call[posn]) )
+    posn++;
+
+  return call.substr(0, posn);
+}
   
 /*! \brief      Remove all instances of a specific leading character
     \param  cs  original string
@@ -199,11 +532,7 @@ bool compare_calls(const string& call1, const string& call2)
     \return     <i>cs</i> with any leading octets with the value <i>c</i> removed
 */
 string remove_leading(const string& cs, const char c)
-{ const size_t posn { cs.find_first_not_of(create_string(c)) };
-  const string rv   { cs.substr(posn) };
-  
-  return rv;
-}
+  { return string(trim_leading(cs, c)); }
 
 /*! \brief      Remove all instances of a specific trailing character
     \param  cs  original string
@@ -211,13 +540,7 @@ string remove_leading(const string& cs, const char c)
     \return     <i>cs</i> with any trailing octets with the value <i>c</i> removed
 */
 string remove_trailing(const string& cs, const char c)
-{ string rv { cs };
-
-  while (rv.length() && (rv[rv.length() - 1] == c))
-    rv = rv.substr(0, rv.length() - 1);
-  
-  return rv;
-}
+  { return string(trim_trailing(cs, c)); }
 
 /// return the current date as YYYY-MM-DD
 string date_string(void)
@@ -243,3 +566,166 @@ string date_string(void)
 
   return _date;
 }
+
+// -----------  memory_mapped_file  ----------------
+
+/*!     \class memory_mapped_file
+        \brief a read-only file mapped into memory
+*/
+
+/*! \brief              Constructor
+    \param  filename    name of file to be mapped
+
+    Throws exception if the file cannot be opened or mapped
+*/
+memory_mapped_file::memory_mapped_file(const string& filename)
+{ const int fd { ::open(filename.c_str(), O_RDONLY) };
+
+  if (fd < 0)
+  { cerr << ("Cannot open file: "s + filename) << endl;
+    throw exception();
+  }
+
+  struct stat stat_buffer;
+
+  if (fstat(fd, &stat_buffer))
+  { ::close(fd);
+    cerr << ("Unable to stat file: "s + filename) << endl;
+    throw exception();
+  }
+
+  _size = static_cast<size_t>(stat_buffer.st_size);
+
+  if (_size)                                                    // can't map an empty file
+  { void* vp { mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0) };
+
+    if (vp == MAP_FAILED)
+    { ::close(fd);
+      cerr << ("Unable to map file: "s + filename) << endl;
+      throw exception();
+    }
+
+    _data = static_cast<const char*>(vp);
+  }
+
+  ::close(fd);                                                  // the mapping remains valid
+}
+
+/// destructor
+memory_mapped_file::~memory_mapped_file(void)
+{ if (_data)
+    munmap(const_cast<char*>(_data), _size);
+}
+
+// -----------  sidecar offset index  ----------------
+
+/*! \brief          Create an index entry
+    \param  call    callsign
+    \param  offset  byte offset of the record whose callsign is <i>call</i>
+    \return         the index entry for <i>call</i> at <i>offset</i>
+*/
+offset_index_entry make_offset_index_entry(const string& call, const uint64_t offset)
+{ offset_index_entry rv;
+
+  rv.key = callsign_key(call);
+  rv.offset = offset;
+
+  return rv;
+}
+
+/*! \brief              Write a sidecar offset index
+    \param  filename    name of file to write
+    \param  entries     the samples, in callsign order
+
+    Throws exception if the file cannot be written
+*/
+void write_offset_index(const string& filename, const vector<offset_index_entry>& entries)
+{ offset_index_header header;
+
+  header.n_entries = entries.size();
+
+  ofstream ofs(filename, ios::binary);
+
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  ofs.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(offset_index_entry));
+
+  if (!ofs)
+  { cerr << ("Error writing index file: "s + filename) << endl;
+    throw exception();
+  }
+}
+
+// -----------  indexed_file  ----------------
+
+/*!     \class indexed_file
+        \brief an output file and its sidecar offset index, both mapped into memory
+*/
+
+/*! \brief                  Constructor
+    \param  text_filename   name of the output file
+    \param  index_filename  name of the sidecar index
+
+    Throws exception if either file cannot be mapped, or if the index is invalid
+*/
+indexed_file::indexed_file(const string& text_filename, const string& index_filename) :
+  _text(text_filename),
+  _index(index_filename)
+{ const string_view index_contents { _index.contents() };
+
+  offset_index_header header;
+
+  if (index_contents.size() >= sizeof(header))
+    memcpy(&header, index_contents.data(), sizeof(header));
+
+  if ( (index_contents.size() < sizeof(header)) or (header.magic != OFFSET_INDEX_MAGIC) or
+       (index_contents.size() != sizeof(header) + header.n_entries * sizeof(offset_index_entry)) )
+  { cerr << ("Invalid index file: "s + index_filename) << endl;
+    throw exception();
+  }
+
+  _entries = span<const offset_index_entry>(reinterpret_cast<const offset_index_entry*>(index_contents.data() + sizeof(header)), header.n_entries);
+}
+
+/*! \brief          Find the record for a particular call
+    \param  call    callsign to find
+    \return         the line in the output file for <i>call</i>, without the trailing LF
+
+    Returns the empty string if <i>call</i> is not present
+*/
+string_view indexed_file::record(const string& call) const
+{ const callsign_key key { call };
+
+// the call, if present, lies between the block that precedes the first sample whose key is not before the call's, and the first sample whose key is after it
+// (the samples between the two have the same key; there are none unless the call is too long for its key to be exact)
+  const auto first { lower_bound(_entries.begin(), _entries.end(), key, [] (const offset_index_entry& entry, const callsign_key& target) { return (entry.key < target); }) };
+  const auto last  { upper_bound(first, _entries.end(), key, [] (const callsign_key& target, const offset_index_entry& entry) { return (target < entry.key); }) };
+
+  if (last == _entries.begin())                       // before the first record
+    return string_view();
+
+  const string_view text  { _text.contents() };
+  const size_t      end   { (last == _entries.end()) ? text.size() : static_cast<size_t>(last->offset) };
+
+  size_t posn { static_cast<size_t>( (first == _entries.begin()) ? first->offset : prev(first)->offset ) };
+
+  while (posn < end)
+  { size_t eol { text.find('\n', posn) };
+
+    if (eol == string_view::npos)
+      eol = text.size();
+
+    const string_view line        { text.substr(posn, eol - posn) };
+    const size_t      field_start { line.find('|') };                               // the callsign is the second field
+
+    if (field_start != string_view::npos)
+    { const size_t field_end { line.find('|', field_start + 1) };
+
+      if (line.substr(field_start + 1, field_end - field_start - 1) == call)
+        return line;
+    }
+
+    posn = eol + 1;
+  }
+
+  return string_view();
+}
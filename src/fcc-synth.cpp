@@ -0,0 +1,399 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-synth.cpp
+
+    Synthetic .DAT records, with realistic distributions of calls, names, places and dates
+*/
+
+#include "fcc-db.h"
+#include "fcc-synth.h"
+
+#include <array>
+
+using namespace std;
+
+constexpr array<const char*, 24> FIRST_NAMES { "James", "John", "Robert", "Michael", "William", "David", "Richard", "Joseph", "Thomas", "Charles",
+                                               "Mary", "Patricia", "Jennifer", "Linda", "Elizabeth", "Barbara", "Susan", "Jessica", "Sarah", "Karen",
+                                               "Christopher", "Daniel", "Margaret", "Bartholomew"
+                                             };
+
+constexpr array<const char*, 24> LAST_NAMES { "Smith", "Johnson", "Williams", "Brown", "Jones", "Garcia", "Miller", "Davis", "Rodriguez", "Martinez",
+                                              "Hernandez", "Lopez", "Gonzalez", "Wilson", "Anderson", "Thomas", "Taylor", "Moore", "Jackson", "Martin",
+                                              "Lee", "Thompson", "White", "Vanderschoot-Winterbottom"
+                                            };
+
+constexpr array<const char*, 12> STREETS { "Main St", "Oak Ave", "Pine Rd", "Maple Dr", "Cedar Ln", "Elm St", "Washington Blvd", "Lake View Ct",
+                                           "Hillcrest Cir", "Park Pl", "N 2nd St", "County Road 1150 E"
+                                         };
+
+/// a city, with its state and the first three digits of its ZIP codes
+struct place
+{ const char* city;
+  const char* state;
+  const char* zip3;
+};
+
+constexpr array<place, 16> PLACES { { { "Portland", "OR", "972" }, { "Seattle", "WA", "981" }, { "Boise", "ID", "837" }, { "Anchorage", "AK", "995" },
+                                      { "Honolulu", "HI", "968" }, { "Dallas", "TX", "752" }, { "Denver", "CO", "802" }, { "Chicago", "IL", "606" },
+                                      { "Atlanta", "GA", "303" }, { "Miami", "FL", "331" }, { "Boston", "MA", "021" }, { "New York", "NY", "100" },
+                                      { "Cleveland", "OH", "441" }, { "Nashville", "TN", "372" }, { "San Juan", "PR", "009" }, { "Saint Louis", "MO", "631" }
+                                  } };
+
+constexpr array<const char*, 6> COMMENTS { "Vanity callsign request", "Address change", "Licensee requested cancellation",
+                                           "Duplicate application dismissed", "Returned mail", "Sequential call granted; previous call retained by club"
+                                         };
+
+constexpr array<const char*, 16> WORDS { "THE", "LICENSEE", "SHALL", "STATION", "AMATEUR", "OPERATION", "REQUEST", "GRANTED", "FREQUENCY", "NOTICE",
+                                         "OF", "AND", "TO", "CLUB", "CERTIFICATION", "RADIO"
+                                       };
+
+/// fields of a record of type T
+template <typename T>
+using fields = array<string, static_cast<size_t>(T::N_FIELDS)>;
+
+/// a field of a record
+template <typename T>
+inline string& field(fields<T>& flds, const T f)
+  { return flds[static_cast<size_t>(f)]; }
+
+/// join the fields of a record with the separator used in .DAT files
+template <size_t N>
+string join_fields(const array<string, N>& flds)
+{ string rv;
+
+  for (size_t n = 0; n < flds.size(); ++n)
+    rv += ( (n ? "|"s : ""s) + flds[n] );
+
+  return rv;
+}
+
+/// a random element of an array
+template <typename C>
+inline auto pick(synth_rng& rng, const C& c)
+  { return c[rng.below(c.size())]; }
+
+/// a string of random decimal digits
+static string digits(synth_rng& rng, const size_t n)
+{ string rv(n, '0');
+
+  for (char& c : rv)
+    c = static_cast<char>('0' + rng.below(10));
+
+  return rv;
+}
+
+/// a string of random upper-case letters
+static string letters(synth_rng& rng, const size_t n)
+{ string rv(n, 'A');
+
+  for (char& c : rv)
+    c = static_cast<char>('A' + rng.below(26));
+
+  return rv;
+}
+
+/*! \brief      A random call, with the distribution of formats found among amateur calls
+    \param  rng the generator
+    \return     a call such as "K7ABC" or "AA2X"
+*/
+string synth_callsign(synth_rng& rng)
+{ static const array<const char*, 4> one_letter_prefixes { "K", "N", "W", "K" };
+
+  const uint64_t format { rng.below(100) };
+
+// roughly: 1x3 is most common, then 2x3, 2x2, 1x2, 2x1
+  if (format < 40)
+    return pick(rng, one_letter_prefixes) + digits(rng, 1) + letters(rng, 3);
+
+  if (format < 75)
+    return "K"s + letters(rng, 1) + digits(rng, 1) + letters(rng, 3);
+
+  if (format < 88)
+    return ( rng.chance(0.5) ? "A"s + static_cast<char>('A' + rng.below(12)) : "K"s + letters(rng, 1) ) + digits(rng, 1) + letters(rng, 2);
+
+  if (format < 96)
+    return pick(rng, one_letter_prefixes) + digits(rng, 1) + letters(rng, 2);
+
+  return "A"s + static_cast<char>('A' + rng.below(12)) + digits(rng, 1) + letters(rng, 1);
+}
+
+/*! \brief          A random date, as used in .DAT files
+    \param  rng     the generator
+    \param  year_lo earliest year
+    \param  year_hi latest year
+    \return         a date in the format MM/DD/YYYY
+*/
+string synth_date(synth_rng& rng, const int year_lo, const int year_hi)
+{ char buf[16];
+
+  snprintf(buf, sizeof(buf), "%02u/%02u/%04u", static_cast<unsigned>(rng.between(1, 12)), static_cast<unsigned>(rng.between(1, 28)),
+           static_cast<unsigned>(rng.between(year_lo, year_hi)));
+
+  return buf;
+}
+
+/*! \brief          Lengthen or shorten some text to a random length
+    \param  rng     the generator
+    \param  text    original text
+    \param  range   range of lengths
+    \return         <i>text</i>, truncated or extended with words to a length in <i>range</i>; <i>text</i> if <i>range</i> is empty
+*/
+string fit_length(synth_rng& rng, const string& text, const length_range& range)
+{ if (range.empty())
+    return text;
+
+  const size_t target { static_cast<size_t>(rng.between(range.lo, max(range.lo, range.hi))) };
+
+  string rv { text };
+
+  while (rv.size() < target)
+    rv += ( (rv.empty() ? ""s : " "s) + pick(rng, WORDS) );
+
+  rv.resize(target);
+
+  while (!rv.empty() and rv.back() == ' ')           // the FCC does not end fields with spaces
+    rv.pop_back();
+
+  return rv;
+}
+
+/*! \brief          Insert a line feed into a field of a record, as the FCC sometimes does
+    \param  rng     the generator
+    \param  line    the record
+    \param  field   index of the field
+    \return         <i>line</i> with a line feed inside field number <i>field</i>; <i>line</i> if the field has fewer than two characters
+*/
+string embed_line_feed(synth_rng& rng, const string& line, const size_t field)
+{ size_t start { 0 };
+
+  for (size_t n = 0; n < field; ++n)
+  { start = line.find('|', start);
+
+    if (start == string::npos)
+      return line;
+
+    start++;
+  }
+
+  const size_t end { min(line.find('|', start), line.size()) };
+
+  if (end - start < 2)
+    return line;
+
+  string rv { line };
+
+  rv.insert(start + 1 + rng.below(end - start - 1), "\n"s);
+
+  return rv;
+}
+
+/*! \brief          An AM (amateur) record
+    \param  rng     the generator
+    \param  id      ID of the record
+    \param  cs      call
+    \param  lengths lengths of the free-text fields
+    \return         the record, without a terminating EOL
+*/
+string synth_am_line(synth_rng& rng, const uint64_t id, const string& cs, const synth_lengths& lengths)
+{ static const array<const char*, 6> classes { "E", "G", "G", "T", "T", "A" };
+
+  fields<AM> flds;
+
+  field(flds, AM::RECORD_TYPE) = "AM"s;
+  field(flds, AM::ID) = ::to_string(id);
+  field(flds, AM::CALLSIGN) = cs;
+  field(flds, AM::OPERATOR_CLASS) = pick(rng, classes);
+  field(flds, AM::GROUP_CODE) = string(1, static_cast<char>('A' + rng.below(4)));
+  field(flds, AM::REGION_CODE) = ::to_string(rng.between(1, 13));
+
+  if (rng.chance(0.2))
+  { field(flds, AM::PREVIOUS_CALLSIGN) = synth_callsign(rng);
+    field(flds, AM::PREVIOUS_OPERATOR_CLASS) = pick(rng, classes);
+  }
+
+  if (rng.chance(0.01))
+  { field(flds, AM::TRUSTEE_CALLSIGN) = synth_callsign(rng);
+    field(flds, AM::TRUSTEE_INDICATOR) = "Y"s;
+    field(flds, AM::TRUSTEE_NAME) = fit_length(rng, pick(rng, FIRST_NAMES) + " "s + pick(rng, LAST_NAMES), lengths.name);
+  }
+
+  return join_fields(flds);
+}
+
+/*! \brief          A CO (comment) record
+    \param  rng     the generator
+    \param  id      ID of the record
+    \param  cs      call
+    \param  lengths lengths of the free-text fields
+    \return         the record, without a terminating EOL
+*/
+string synth_co_line(synth_rng& rng, const uint64_t id, const string& cs, const synth_lengths& lengths)
+{ fields<CO> flds;
+
+  field(flds, CO::RECORD_TYPE) = "CO"s;
+  field(flds, CO::ID) = ::to_string(id);
+  field(flds, CO::CALLSIGN) = cs;
+  field(flds, CO::COMMENT_DATE) = synth_date(rng, 2005, 2023);
+  field(flds, CO::DESCRIPTION) = fit_length(rng, pick(rng, COMMENTS), lengths.comment);
+
+  return join_fields(flds);
+}
+
+/*! \brief          An EN (entity) record
+    \param  rng     the generator
+    \param  id      ID of the record
+    \param  cs      call
+    \param  lengths lengths of the free-text fields
+    \return         the record, without a terminating EOL
+*/
+string synth_en_line(synth_rng& rng, const uint64_t id, const string& cs, const synth_lengths& lengths)
+{ fields<EN> flds;
+
+  const string first  { pick(rng, FIRST_NAMES) };
+  const string last   { pick(rng, LAST_NAMES) };
+  const string mi     { rng.chance(0.6) ? letters(rng, 1) : ""s };
+  const place& p      { PLACES[rng.below(PLACES.size())] };
+
+  field(flds, EN::RECORD_TYPE) = "EN"s;
+  field(flds, EN::ID) = ::to_string(id);
+  field(flds, EN::CALLSIGN) = cs;
+  field(flds, EN::ENTITY_TYPE) = "L"s;
+  field(flds, EN::LICENSE_ID) = "L"s + digits(rng, 8);
+  field(flds, EN::ENTITY_NAME) = fit_length(rng, last + ", "s + first + (mi.empty() ? ""s : " "s + mi), lengths.name);
+  field(flds, EN::FIRST_NAME) = first;
+  field(flds, EN::MIDDLE_INITIAL) = mi;
+  field(flds, EN::LAST_NAME) = last;
+  field(flds, EN::SUFFIX) = rng.chance(0.03) ? "Jr"s : ""s;
+
+  if (rng.chance(0.3))
+    field(flds, EN::EMAIL) = to_upper(first) + "@EXAMPLE.COM"s;
+
+  field(flds, EN::STREET_ADDRESS) = fit_length(rng, ::to_string(rng.between(1, 29999)) + " "s + pick(rng, STREETS), lengths.address);
+  field(flds, EN::CITY) = p.city;
+  field(flds, EN::STATE) = p.state;
+  field(flds, EN::ZIP_CODE) = p.zip3 + digits(rng, rng.chance(0.5) ? 2 : 6);
+
+  if (rng.chance(0.05))
+    field(flds, EN::PO_BOX) = ::to_string(rng.between(1, 9999));
+
+  field(flds, EN::FRN) = "00"s + digits(rng, 8);
+  field(flds, EN::APPLICANT_TYPE_CODE) = "I"s;
+
+  return join_fields(flds);
+}
+
+/*! \brief              An HD (header) record
+    \param  rng         the generator
+    \param  id          ID of the record
+    \param  cs          call
+    \param  expired     whether the licence has expired
+    \param  cancelled   whether the licence has been cancelled
+    \return             the record, without a terminating EOL
+*/
+string synth_hd_line(synth_rng& rng, const uint64_t id, const string& cs, const bool expired, const bool cancelled)
+{ fields<HD> flds;
+
+  field(flds, HD::RECORD_TYPE) = "HD"s;
+  field(flds, HD::ID) = ::to_string(id);
+  field(flds, HD::CALLSIGN) = cs;
+  field(flds, HD::LICENSE_STATUS) = (cancelled ? "C"s : (expired ? "E"s : "A"s));
+  field(flds, HD::RADIO_SERVICE_CODE) = rng.chance(0.02) ? "HV"s : "HA"s;
+  field(flds, HD::GRANT_DATE) = synth_date(rng, 2005, 2015);
+  field(flds, HD::EXPIRED_DATE) = (expired ? synth_date(rng, 2010, 2020) : synth_date(rng, 2031, 2035));      // well clear of any date on which the files are likely to be processed
+
+  if (cancelled)
+    field(flds, HD::CANCELLATION_DATE) = synth_date(rng, 2016, 2020);
+
+  field(flds, HD::EFFECTIVE_DATE) = synth_date(rng, 2015, 2020);
+  field(flds, HD::LAST_ACTION_DATE) = synth_date(rng, 2015, 2020);
+
+  return join_fields(flds);
+}
+
+/*! \brief      An HS (history) record
+    \param  rng the generator
+    \param  id  ID of the record
+    \param  cs  call
+    \return     the record, without a terminating EOL
+*/
+string synth_hs_line(synth_rng& rng, const uint64_t id, const string& cs)
+{ static const array<const char*, 8> codes { "LIISS", "LIREN", "LIMOD", "LIEXP", "LICAN", "SYSEXP", "LIPUR", "LIVAN" };
+
+  fields<HS> flds;
+
+  field(flds, HS::RECORD_TYPE) = "HS"s;
+  field(flds, HS::ID) = ::to_string(id);
+  field(flds, HS::ULS_NUMBER) = "000"s + digits(rng, 7);
+  field(flds, HS::CALLSIGN) = cs;
+  field(flds, HS::LOG_DATE) = synth_date(rng, 2000, 2023);
+  field(flds, HS::CODE) = pick(rng, codes);
+
+  return join_fields(flds);
+}
+
+/*! \brief          An LA (licence attachment) record
+    \param  rng     the generator
+    \param  id      ID of the record
+    \param  cs      call
+    \param  lengths lengths of the free-text fields
+    \return         the record, without a terminating EOL
+*/
+string synth_la_line(synth_rng& rng, const uint64_t id, const string& cs, const synth_lengths& lengths)
+{ fields<LA> flds;
+
+  field(flds, LA::RECORD_TYPE) = "LA"s;
+  field(flds, LA::ID) = ::to_string(id);
+  field(flds, LA::CALLSIGN) = cs;
+  field(flds, LA::ATTACHMENT_CODE) = "C"s;
+  field(flds, LA::ATTACHMENT_DESCRIPTION) = fit_length(rng, "Club station certification"s, lengths.comment);
+  field(flds, LA::ATTACHMENT_DATE) = synth_date(rng, 2005, 2023);
+  field(flds, LA::ATTACHMENT_FILENAME) = "attachment_"s + digits(rng, 8) + ".pdf"s;
+  field(flds, LA::ACTION_PERFORMED) = "A"s;
+
+  return join_fields(flds);
+}
+
+/*! \brief      An SC (special condition) record
+    \param  rng the generator
+    \param  id  ID of the record
+    \param  cs  call
+    \return     the record, without a terminating EOL
+*/
+string synth_sc_line(synth_rng& rng, const uint64_t id, const string& cs)
+{ fields<SC> flds;
+
+  field(flds, SC::RECORD_TYPE) = "SC"s;
+  field(flds, SC::ID) = ::to_string(id);
+  field(flds, SC::CALLSIGN) = cs;
+  field(flds, SC::SPECIAL_CONDITION_TYPE) = "P"s;
+  field(flds, SC::SPECIAL_CONDITION_CODE) = ::to_string(rng.between(1, 999));
+
+  return join_fields(flds);
+}
+
+/*! \brief          An SF (free-form special condition) record
+    \param  rng     the generator
+    \param  id      ID of the record
+    \param  cs      call
+    \param  lengths lengths of the free-text fields
+    \return         the record, without a terminating EOL
+*/
+string synth_sf_line(synth_rng& rng, const uint64_t id, const string& cs, const synth_lengths& lengths)
+{ fields<SF> flds;
+
+  field(flds, SF::RECORD_TYPE) = "SF"s;
+  field(flds, SF::ID) = ::to_string(id);
+  field(flds, SF::CALLSIGN) = cs;
+  field(flds, SF::LICENSE_FREEFORM_TYPE) = "L"s;
+  field(flds, SF::UNIQUE_LICENSE_FREEFORM_ID) = ::to_string(rng.between(1'000'000, 9'999'999));
+  field(flds, SF::SEQUENCE_NUMBER) = "1"s;
+  field(flds, SF::LICENSE_FREEFORM_CONDITION) = fit_length(rng, "The licensee shall not operate within the restricted zone"s, lengths.comment);
+
+  return join_fields(flds);
+}
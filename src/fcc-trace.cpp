@@ -0,0 +1,173 @@
+// Released under the GNU Public License, version 2
+//   see: https://www.gnu.org/licenses/gpl-2.0.html
+
+// Principal author: N7DR
+
+// Copyright owners:
+//    N7DR
+
+/*! \file   fcc-trace.cpp
+
+    Spans of execution on each thread, written as Chrome trace-event JSON
+*/
+
+#include "fcc-trace.h"
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+/// a completed span
+struct trace_event
+{ array<char, 48> name;                   ///< name of the span, NUL-terminated
+  int64_t         start_ns { 0 };         ///< start, relative to trace_epoch
+  int64_t         dur_ns   { 0 };         ///< duration
+};
+
+/// the spans recorded by a single thread
+struct trace_buffer
+{ pid_t               tid;                                    ///< the thread
+  vector<trace_event> events { TRACE_BUFFER_SIZE };           ///< ring buffer of spans
+  atomic<uint64_t>    n_events { 0 };                         ///< total number of spans recorded; the next is written at n_events % TRACE_BUFFER_SIZE
+};
+
+static const steady_clock::time_point trace_epoch { steady_clock::now() };     ///< time zero of the trace
+
+static atomic<bool>                     trace_is_enabled { false };
+static string                           trace_filename;                         ///< written only by start_tracing()
+static mutex                            buffers_mutex;
+static vector<unique_ptr<trace_buffer>> buffers;                                ///< protected by buffers_mutex; outlive the threads that own them
+
+static thread_local trace_buffer* this_thread_buffer { nullptr };
+
+/// the buffer for the calling thread, creating it if necessary
+static trace_buffer& thread_buffer(void)
+{ if (!this_thread_buffer)
+  { auto buffer_p { make_unique<trace_buffer>() };
+
+    buffer_p->tid = gettid();
+    this_thread_buffer = buffer_p.get();
+
+    lock_guard<mutex> lock(buffers_mutex);
+
+    buffers.push_back(std::move(buffer_p));
+  }
+
+  return *this_thread_buffer;
+}
+
+/// write the trace when the program exits; errors are reported but otherwise ignored
+static void write_trace_at_exit(void)
+{ trace_is_enabled = false;
+
+  try
+  { write_trace(trace_filename);
+  }
+
+  catch (...)
+  { }
+}
+
+/*! \brief              Start recording spans
+    \param  filename    name of the file to which the trace is written when the program exits
+*/
+void start_tracing(const string& filename)
+{ if (trace_is_enabled.exchange(true))
+    return;
+
+  trace_filename = filename;
+  atexit(write_trace_at_exit);
+}
+
+/// is tracing active?
+bool tracing_enabled(void)
+  { return trace_is_enabled.load(memory_order_relaxed); }
+
+/*! \brief          Record a span on the calling thread
+    \param  name    name of the span
+    \param  start   time at which the span started
+    \param  end     time at which the span ended
+
+    Does nothing if tracing is not active. Names longer than 47 characters are truncated
+*/
+void trace_span(const string& name, const steady_clock::time_point start, const steady_clock::time_point end)
+{ if (!tracing_enabled())
+    return;
+
+  trace_buffer&    buffer { thread_buffer() };
+  const uint64_t   n      { buffer.n_events.load(memory_order_relaxed) };
+  trace_event&     event  { buffer.events[n % TRACE_BUFFER_SIZE] };
+  const size_t     len    { min(name.size(), event.name.size() - 1) };
+
+  memcpy(event.name.data(), name.data(), len);
+  event.name[len] = '\0';
+  event.start_ns = duration_cast<nanoseconds>(start - trace_epoch).count();
+  event.dur_ns = duration_cast<nanoseconds>(end - start).count();
+
+  buffer.n_events.store(n + 1, memory_order_release);
+}
+
+/*! \brief              Write all the recorded spans
+    \param  filename    name of the file to which the trace is written
+
+    Should be called only when no other thread is recording spans.
+    Throws exception if the file cannot be written
+*/
+void write_trace(const string& filename)
+{ ofstream ofs(filename);
+
+  const pid_t pid { getpid() };
+
+  ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  bool first { true };
+  char buf[256];
+
+  lock_guard<mutex> lock(buffers_mutex);
+
+  for (const auto& buffer_p : buffers)
+  { const uint64_t n     { buffer_p->n_events.load(memory_order_acquire) };
+    const uint64_t begin { (n > TRACE_BUFFER_SIZE) ? n - TRACE_BUFFER_SIZE : 0 };
+
+    snprintf(buf, sizeof(buf), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+             (first ? "" : ","), pid, buffer_p->tid, (buffer_p->tid == pid ? "main" : "thread"), buffer_p->tid);
+    ofs << buf;
+    first = false;
+
+    for (uint64_t i = begin; i < n; ++i)
+    { const trace_event& event { buffer_p->events[i % TRACE_BUFFER_SIZE] };
+
+      string name;
+
+      for (const char* cp = event.name.data(); *cp; ++cp)       // escape the name for JSON
+      { if (*cp == '"' or *cp == '\\')
+          name += '\\';
+
+        if (static_cast<unsigned char>(*cp) >= ' ')
+          name += *cp;
+      }
+
+      snprintf(buf, sizeof(buf), ",\n{\"name\":\"%s\",\"cat\":\"fcc-db\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+               name.c_str(), event.start_ns / 1e3, event.dur_ns / 1e3, pid, buffer_p->tid);
+      ofs << buf;
+    }
+  }
+
+  ofs << "\n]}\n";
+
+  if (!ofs)
+  { cerr << ("Error writing trace file: "s + filename) << endl;
+    throw exception();
+  }
+}